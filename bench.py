@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+
+#
+# 运行内核微基准测试并与基线比较（由 make bench 调用）
+#
+# ./bench.py                   (编译 BENCH=1 内核，运行并与 bench_baseline.txt 比较)
+# ./bench.py --save-baseline   (把本次结果保存为新的基线)
+# ./bench.py --threshold 0.2   (比基线慢 20% 以上才算退化，默认 10%)
+#
+# 内核输出 "BENCH <名称> <数值> <单位>" 形式的行，以 "BENCH done" 结束。
+# 结果写入 bench_output.txt；有任何一项退化时以非零状态退出。
+
+import argparse, os, re, signal, subprocess, sys, time
+from subprocess import run
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--baseline", default="bench_baseline.txt", help="baseline results file")
+parser.add_argument("--output", default="bench_output.txt", help="where to write this run's results")
+parser.add_argument("--threshold", type=float, default=0.10, help="allowed slowdown before flagging a regression")
+parser.add_argument("--timeout", type=int, default=120, help="seconds to wait for the benchmarks")
+parser.add_argument("--save-baseline", action='store_true', help="store this run as the new baseline")
+args = parser.parse_args()
+
+BENCH_RE = re.compile(r'^BENCH (\S+) (\d+) (\S+)\s*$')
+
+class QEMU(object):
+
+    def __init__(self):
+        self.build_kernel()
+        q = ["make", "BENCH=1", "run"]
+        # 放进独立的进程组，结束时连同 make 启动的 qemu 一起终止
+        self.proc = subprocess.Popen(q, stdin=subprocess.PIPE,
+                                      stdout=subprocess.PIPE,
+                                      stderr=subprocess.STDOUT,
+                                      start_new_session=True)
+        self.output = ""
+        self.outbytes = bytearray()
+
+    def build_kernel(self):
+        try:
+            run(["make", "BENCH=1", "kernel/kernel"], check=True)
+        except subprocess.CalledProcessError as e:
+            print(f"Command failed with exit code {e.returncode}")
+            sys.exit(1)
+
+    def stop(self):
+        try:
+            os.killpg(self.proc.pid, signal.SIGTERM)
+        except ProcessLookupError:
+            pass
+        self.proc.wait()
+
+    def read(self):
+        buf = os.read(self.proc.stdout.fileno(), 4096)
+        if not buf:
+            return False
+        self.outbytes.extend(buf)
+        self.output = self.outbytes.decode("utf-8", "replace")
+        return True
+
+    def lines(self):
+        return self.output.splitlines()
+
+    def error(self, msg):
+        print("FAIL:", msg)
+        print(self.output)
+        self.stop()
+        sys.exit(1)
+
+    def monitor(self, regexp, timeout):
+        deadline = time.time() + timeout
+        while not any(re.match(regexp, l) for l in self.lines()):
+            if time.time() > deadline:
+                self.error("timed out waiting for %s" % regexp)
+            if not self.read():
+                self.error("qemu exited early")
+
+def parse(lines):
+    results = {}
+    for line in lines:
+        m = BENCH_RE.match(line.strip())
+        if m:
+            results[m.group(1)] = (int(m.group(2)), m.group(3))
+    return results
+
+def load(path):
+    with open(path) as f:
+        return parse(f.read().splitlines())
+
+def save(path, results):
+    with open(path, "w") as f:
+        for name, (value, unit) in results.items():
+            f.write("BENCH %s %d %s\n" % (name, value, unit))
+
+def compare(results, baseline):
+    regressions = 0
+    print("%-20s %12s %12s %8s" % ("benchmark", "baseline", "current", "change"))
+    for name, (value, unit) in results.items():
+        if name not in baseline:
+            print("%-20s %12s %12d %8s  (new)" % (name, "-", value, unit))
+            continue
+        base = baseline[name][0]
+        change = (value - base) / base if base else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print("%-20s %12d %12d %+7.1f%%%s" % (name, base, value, change * 100, flag))
+    for name in baseline:
+        if name not in results:
+            print("%-20s missing from this run" % name)
+    return regressions
+
+def main():
+    q = QEMU()
+    q.monitor(r'^BENCH done', timeout=args.timeout)
+    q.stop()
+
+    results = parse(q.lines())
+    save(args.output, results)
+    print("%d results written to %s" % (len(results), args.output))
+
+    if args.save_baseline:
+        save(args.baseline, results)
+        print("baseline saved to", args.baseline)
+        return
+    if not os.path.exists(args.baseline):
+        print("no baseline at %s; run with --save-baseline to create one" % args.baseline)
+        return
+
+    regressions = compare(results, load(args.baseline))
+    if regressions:
+        print("FAIL: %d benchmark(s) regressed by more than %d%%" % (regressions, args.threshold * 100))
+        sys.exit(1)
+    print("OK")
+
+main()
@@ -0,0 +1,136 @@
+// ASID 分配器
+// 页表的 ASID 上下文（代号 | ASID）保存在根页表所在物理页的私有字中。
+// 上下文的代号与当前代号不同时，说明该 ASID 已在回绕中失效，需要重新分配。
+// 回绕时各 hart 正在使用的 ASID 被保留下来，因此运行中的地址空间不受影响。
+#include "types.h"
+#include "riscv.h"
+#include "param.h"
+#include "spinlock.h"
+#include "kalloc.h"
+#include "cpu.h"
+#include "asid.h"
+#include "printf.h"
+
+#define ASID_GEN_SHIFT 16
+#define ASID_GEN_MASK  (~(uint64)SATP_ASID_MASK)
+#define ASID_MAX       (1 << ASID_GEN_SHIFT)
+
+int asid_bits;
+uint64 asid_rollovers;
+
+static struct {
+  struct spinlock lock;
+  volatile uint64 generation;   // 当前代号，低 ASID_GEN_SHIFT 位为0
+  uint64 map[ASID_MAX / 64];    // 当前代已分配的 ASID 位图
+  uint64 reserved[NCPU];        // 回绕时各 hart 正在使用的上下文
+  uint next;                    // 下一次查找空闲 ASID 的起点
+  uint nasids;
+} asids;
+
+void asid_init(void) {
+  initlock(&asids.lock, "asid");
+  asids.generation = 1UL << ASID_GEN_SHIFT;
+
+  // ASID 字段是 WARL：写入全1后读回，未实现的高位读出为0
+  uint64 satp = r_satp();
+  w_satp(satp | (SATP_ASID_MASK << SATP_ASID_SHIFT));
+  uint64 mask = (r_satp() >> SATP_ASID_SHIFT) & SATP_ASID_MASK;
+  w_satp(satp);
+  sfence_vma();
+
+  asid_bits = 0;
+  while (mask & (1UL << asid_bits))
+    asid_bits++;
+  asids.nasids = 1u << asid_bits;
+  asids.map[0] = 1;  // ASID 0 留给内核页表
+  asids.next = 1;
+}
+
+// 代号加一，只保留各 hart 正在使用的 ASID，并要求所有 hart 在下次切换前刷新 TLB
+static void rollover(void) {
+  asids.generation += 1UL << ASID_GEN_SHIFT;
+  __sync_synchronize();
+  for (int i = 0; i < ASID_MAX / 64; i++)
+    asids.map[i] = 0;
+  asids.map[0] = 1;
+  for (int i = 0; i < NCPU; i++) {
+    uint64 ctx = cpus[i].asid_ctx;
+    asids.reserved[i] = ctx;
+    if (ctx != 0) {
+      uint asid = ctx & SATP_ASID_MASK;
+      asids.map[asid / 64] |= 1UL << (asid % 64);
+    }
+    cpus[i].asid_flush = 1;
+  }
+  asids.next = 1;
+  asid_rollovers++;
+}
+
+// 为上下文 ctx 分配当前代的 ASID，调用者持有 asids.lock
+static uint64 new_context(uint64 ctx) {
+  // 回绕时正在某个 hart 上运行的地址空间沿用原来的 ASID
+  if (ctx != 0) {
+    for (int i = 0; i < NCPU; i++) {
+      if (asids.reserved[i] == ctx)
+        return asids.generation | (ctx & SATP_ASID_MASK);
+    }
+  }
+
+  for (int pass = 0; pass < 2; pass++) {
+    for (uint asid = asids.next; asid < asids.nasids; asid++) {
+      if (!(asids.map[asid / 64] & (1UL << (asid % 64)))) {
+        asids.map[asid / 64] |= 1UL << (asid % 64);
+        asids.next = asid + 1;
+        return asids.generation | asid;
+      }
+    }
+    rollover();
+  }
+  panic("asid: no free asid");
+  return 0;
+}
+
+uint64 asid_acquire(pagetable_t pagetable) {
+  if (asid_bits == 0) {
+    // 不支持 ASID：所有地址空间共用 ASID 0，由调用者整体刷新；这里只标记页表已被载入过
+    kpage_set_private(pagetable, asids.generation);
+    return 0;
+  }
+
+  struct cpu *c = mycpu();
+  uint64 ctx = kpage_private(pagetable);
+
+  // 快速路径：先公布本 hart 将使用的上下文再检查代号，
+  // 这样并发的回绕要么能看到它并保留该 ASID，要么被本 hart 察觉而走慢速路径
+  c->asid_ctx = ctx;
+  __sync_synchronize();
+  if (ctx == 0 || (ctx & ASID_GEN_MASK) != asids.generation) {
+    acquire(&asids.lock);
+    ctx = kpage_private(pagetable);
+    if (ctx == 0 || (ctx & ASID_GEN_MASK) != asids.generation) {
+      ctx = new_context(ctx);
+      kpage_set_private(pagetable, ctx);
+    }
+    c->asid_ctx = ctx;
+    release(&asids.lock);
+  }
+
+  if (c->asid_flush) {
+    c->asid_flush = 0;
+    sfence_vma();
+  }
+  return ctx & SATP_ASID_MASK;
+}
+
+uint64 asid_of(pagetable_t pagetable) {
+  uint64 ctx = kpage_private(pagetable);
+  if (ctx == 0)
+    return ASID_NONE;
+  // 已失效的上下文也可能还有 TLB 项残留（回绕后尚未切换的 hart），照常按其 ASID 刷新
+  return asid_bits ? (ctx & SATP_ASID_MASK) : 0;
+}
+
+void asid_release(pagetable_t pagetable) {
+  // ASID 本身不回收：其他 hart 的 TLB 中可能仍有它的项，直到下一次回绕才能复用
+  kpage_set_private(pagetable, 0);
+}
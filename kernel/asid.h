@@ -0,0 +1,41 @@
+#ifndef ASID_H
+#define ASID_H
+
+// 地址空间标识符（ASID）分配器头文件
+// 每个用户页表在首次被载入时获得一个 ASID，切换地址空间时只需写 satp，
+// 不必整体刷新 TLB。ASID 用尽时代号加一并整体回绕，各 hart 在下次切换前刷新一次 TLB。
+
+#include "types.h"
+#include "riscv.h"
+
+#define ASID_NONE ((uint64)-1)
+
+extern int asid_bits;          // 硬件实现的 ASID 位数，0 表示不支持
+extern uint64 asid_rollovers;  // 回绕次数
+
+/**
+ * 探测硬件支持的 ASID 位数并初始化分配器
+ * @note 须在启动 hart 开启分页之后、其他 hart 启动之前调用
+ */
+void asid_init(void);
+
+/**
+ * 为即将载入的页表取得当前代的 ASID，必要时重新分配
+ * @param pagetable 用户页表（不能是内核页表）
+ * @return 写入 satp 的 ASID；硬件不支持 ASID 时返回0
+ * @note 须在关中断状态下调用，并同时把结果记为本 hart 的当前地址空间
+ */
+uint64 asid_acquire(pagetable_t pagetable);
+
+/**
+ * 查询页表使用过的 ASID，用于按 ASID 刷新 TLB
+ * @return 页表从未被载入过（不可能有 TLB 项）时返回 ASID_NONE
+ */
+uint64 asid_of(pagetable_t pagetable);
+
+/**
+ * 页表销毁前清除其 ASID 记录
+ */
+void asid_release(pagetable_t pagetable);
+
+#endif // ASID_H
@@ -0,0 +1,185 @@
+// 内核微基准测试
+// 每项测试重复 BENCH_ROUNDS 轮，报告每次操作耗时的中位数，减少 QEMU 调度抖动的影响。
+// 周期数来自 cycle CSR，墙钟时间来自 time CSR（TIMEBASE_FREQ）。
+#include "types.h"
+#include "riscv.h"
+#include "param.h"
+#include "memlayout.h"
+#include "kalloc.h"
+#include "vm.h"
+#include "string.h"
+#include "pageops.h"
+#include "printf.h"
+#include "bench.h"
+
+#define BENCH_ROUNDS 9
+#define BENCH_PAGES  512  // walk / mappages 测试映射的页数
+#define BENCH_VA     USERBASE
+
+static uint64 samples[BENCH_ROUNDS];
+
+// 插入排序后取中位数，样本很少
+static uint64 median(void) {
+  for (int i = 1; i < BENCH_ROUNDS; i++) {
+    uint64 v = samples[i];
+    int j = i - 1;
+    while (j >= 0 && samples[j] > v) {
+      samples[j + 1] = samples[j];
+      j--;
+    }
+    samples[j + 1] = v;
+  }
+  return samples[BENCH_ROUNDS / 2];
+}
+
+static void report(const char *name, uint64 value, const char *unit) {
+  printf("BENCH %s %lu %s\n", name, value, unit);
+}
+
+// 每阶分配 / 释放若干块，分别计时；0 阶走 kalloc 的单页缓存路径，
+// 高阶走 kalloc_pages，两者都包括清零
+static void bench_kalloc(void) {
+  static void *blocks[64];
+  char name[32];
+
+  for (int order = 0; order <= KALLOC_MAX_ORDER; order++) {
+    int n = order < 4 ? 64 : 64 >> (order - 3);
+    if (n < 2)
+      n = 2;
+    uint64 allocs[BENCH_ROUNDS], frees[BENCH_ROUNDS];
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+      uint64 t0 = r_cycle();
+      for (int i = 0; i < n; i++)
+        blocks[i] = order == 0 ? kalloc() : kalloc_pages(1 << order);
+      uint64 t1 = r_cycle();
+      for (int i = 0; i < n; i++) {
+        if (blocks[i] == 0)
+          panic("bench_kalloc: out of memory");
+        kfree(blocks[i]);
+      }
+      uint64 t2 = r_cycle();
+      allocs[r] = (t1 - t0) / n;
+      frees[r] = (t2 - t1) / n;
+    }
+    memcpy(samples, allocs, sizeof(samples));
+    sprintf(name, "kalloc_o%d", order);
+    report(name, median(), "cycles");
+    memcpy(samples, frees, sizeof(samples));
+    sprintf(name, "kfree_o%d", order);
+    report(name, median(), "cycles");
+  }
+}
+
+// 逐页建立映射，再逐页查找，最后拆除
+static void bench_pagetable(void) {
+  uint64 map[BENCH_ROUNDS], look[BENCH_ROUNDS];
+  static void *pages[BENCH_PAGES];
+
+  for (int i = 0; i < BENCH_PAGES; i++) {
+    pages[i] = kalloc();
+    if (pages[i] == 0)
+      panic("bench_pagetable: out of memory");
+  }
+
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    pagetable_t pt = uvmcreate();
+    if (pt == 0)
+      panic("bench_pagetable: uvmcreate");
+
+    uint64 t0 = r_cycle();
+    for (int i = 0; i < BENCH_PAGES; i++)
+      mappages(pt, BENCH_VA + (uint64)i * PGSIZE, PGSIZE, (uint64)pages[i], PTE_R | PTE_W);
+    uint64 t1 = r_cycle();
+    for (int i = 0; i < BENCH_PAGES; i++) {
+      if (walk(pt, BENCH_VA + (uint64)i * PGSIZE, 0) == 0)
+        panic("bench_pagetable: walk");
+    }
+    uint64 t2 = r_cycle();
+
+    uvmunmap(pt, BENCH_VA, BENCH_PAGES, 0);
+    destroy_pagetable(pt);
+    map[r] = (t1 - t0) / BENCH_PAGES;
+    look[r] = (t2 - t1) / BENCH_PAGES;
+  }
+
+  for (int i = 0; i < BENCH_PAGES; i++)
+    kfree(pages[i]);
+
+  memcpy(samples, map, sizeof(samples));
+  report("mappages_4k", median(), "cycles");
+  memcpy(samples, look, sizeof(samples));
+  report("walk", median(), "cycles");
+}
+
+// 建立完整内核页表（与 kvminit 相同的映射）
+static void bench_kvminit(void) {
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    uint64 t0 = r_time();
+    pagetable_t pt = kvmmake(GIGAPGSIZE);
+    samples[r] = (r_time() - t0) / (TIMEBASE_FREQ / 1000000);
+    destroy_pagetable(pt);
+  }
+  report("kvminit", median(), "us");
+}
+
+static void bench_memops(void) {
+  char *a = kalloc();
+  char *b = kalloc();
+  if (a == 0 || b == 0)
+    panic("bench_memops: out of memory");
+
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    uint64 t0 = r_cycle();
+    memset(a, r, PGSIZE);
+    samples[r] = r_cycle() - t0;
+  }
+  report("memset_4k", median(), "cycles");
+
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    uint64 t0 = r_cycle();
+    memcpy(b, a, PGSIZE);
+    samples[r] = r_cycle() - t0;
+  }
+  report("memcpy_4k", median(), "cycles");
+
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    uint64 t0 = r_cycle();
+    page_zero(a, 1);
+    samples[r] = r_cycle() - t0;
+  }
+  report(pageops_vector ? "page_zero_rvv" : "page_zero_scalar", median(), "cycles");
+
+  kfree(a);
+  kfree(b);
+}
+
+// 格式化开销（sprintf）与经控制台缓冲输出一整行的开销（printf）
+static void bench_printf(void) {
+  char buf[128];
+
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    uint64 t0 = r_cycle();
+    for (int i = 0; i < 16; i++)
+      sprintf(buf, "hart %d va %p len %x %s\n", i, (void *)BENCH_VA, i * PGSIZE, "bench");
+    samples[r] = (r_cycle() - t0) / 16;
+  }
+  report("sprintf", median(), "cycles");
+
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    uint64 t0 = r_cycle();
+    printf("# printf bench %d %p %x\n", r, (void *)BENCH_VA, r * PGSIZE);
+    samples[r] = r_cycle() - t0;
+  }
+  report("printf_line", median(), "cycles");
+}
+
+void bench_suite(void) {
+  printf("=== Kernel Micro-benchmarks ===\n");
+  bench_kalloc();
+  bench_pagetable();
+  bench_kvminit();
+  bench_memops();
+  bench_printf();
+  printf("BENCH done\n");
+  printf_flush();
+}
@@ -0,0 +1,13 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// 内核微基准测试（BENCH=1 编译时代替正确性测试运行）
+// 每项结果输出一行 "BENCH <名称> <数值> <单位>"，全部完成后输出 "BENCH done"，
+// 由仓库根目录的 bench.py 收集并与基线比较
+
+/**
+ * 运行全部微基准测试，需在所有子系统初始化之后调用
+ */
+void bench_suite(void);
+
+#endif // BENCH_H
@@ -0,0 +1,265 @@
+// 连续内存区（CMA）
+// 两张位图各一位对应一页：used 表示被连续分配占用（或正在为连续分配回收），
+// lent 表示借给了可移动的单页分配。两位都为0的页空闲。
+// 借出页的页私有字记录映射它的 PTE 地址（反向映射），由 uvm_migrate 据此迁移。
+#include "types.h"
+#include "riscv.h"
+#include "param.h"
+#include "spinlock.h"
+#include "kalloc.h"
+#include "pageops.h"
+#include "printf.h"
+#include "vm.h"
+#include "fdt.h"
+#include "cma.h"
+
+static struct {
+  struct spinlock lock;
+  uint64 base;
+  int npages;
+  int nwords;
+  uint64 *used;
+  uint64 *lent;
+  int hint;       // 下一次借出时开始搜索的字，避免总是从头扫描
+  int nused;
+  int nlent;
+  uint64 allocs;
+  uint64 failures;
+  uint64 migrated;
+} cma;
+
+#define TEST(map, i)  (((map)[(i) / 64] >> ((i) % 64)) & 1)
+#define SET(map, i)   ((map)[(i) / 64] |= 1UL << ((i) % 64))
+#define CLEAR(map, i) ((map)[(i) / 64] &= ~(1UL << ((i) % 64)))
+
+int cma_configured_pages(void) {
+  uint64 bytes = (uint64)CMA_MB << 20;
+  for (const char *s = fdt_bootargs; s && *s; s++) {
+    if ((s == fdt_bootargs || s[-1] == ' ') && s[0] == 'c' && s[1] == 'm' && s[2] == 'a' && s[3] == '=') {
+      bytes = 0;
+      for (s += 4; *s >= '0' && *s <= '9'; s++)
+        bytes = bytes * 10 + (*s - '0');
+      if (*s == 'K' || *s == 'k')
+        bytes <<= 10;
+      else if (*s == 'M' || *s == 'm')
+        bytes <<= 20;
+      else if (*s == 'G' || *s == 'g')
+        bytes <<= 30;
+      break;
+    }
+  }
+  return bytes / PGSIZE;
+}
+
+void cma_init(uint64 base, int npages) {
+  initlock(&cma.lock, "cma");
+  if (npages <= 0)
+    return;
+
+  cma.nwords = (npages + 63) / 64;
+  uint64 bytes = 2 * cma.nwords * sizeof(uint64);
+  uint64 *maps = kalloc_pages((bytes + PGSIZE - 1) / PGSIZE);  // 已清零
+  if (maps == 0) {
+    printf("cma: no memory for bitmaps, disabled\n");
+    return;
+  }
+  cma.used = maps;
+  cma.lent = maps + cma.nwords;
+  // 最后一个字中超出区域的位永久标记为占用
+  for (int i = npages; i < cma.nwords * 64; i++)
+    SET(cma.used, i);
+  cma.base = base;
+  cma.npages = npages;
+  printf("cma: %d KB contiguous region at %p\n", npages * (PGSIZE / 1024), (void *)base);
+}
+
+int cma_contains(void *pa) {
+  return (uint64)pa >= cma.base && (uint64)pa < cma.base + (uint64)cma.npages * PGSIZE;
+}
+
+static void *cma_page(int i) {
+  return (void *)(cma.base + (uint64)i * PGSIZE);
+}
+
+// 借出的页能否迁移：需要有反向映射且没有被共享
+// 写时复制共享过的页，反向映射记录的一方复制走或解除映射后就被清零，直到剩下的一方写入前都无法迁移
+static int migratable(int i) {
+  void *pa = cma_page(i);
+  return kpage_private(pa) != 0 && kpage_refcount(pa) == 1;
+}
+
+// 从 from 开始找 n 个连续页：allow_lent 为0时只接受空闲页，否则也接受可迁移的借出页
+// 返回起始页号，找不到返回-1，调用者须持有 cma.lock
+static int find_run(int from, int n, int allow_lent) {
+  int start = from, len = 0;
+  for (int i = from; i < cma.npages; i++) {
+    // 整个字都不可用时一次跳过 64 页
+    if (i % 64 == 0) {
+      uint64 busy = cma.used[i / 64] | (allow_lent ? 0 : cma.lent[i / 64]);
+      if (busy == ~0UL) {
+        len = 0;
+        start = i + 64;
+        i += 63;
+        continue;
+      }
+    }
+    if (TEST(cma.used, i) || (TEST(cma.lent, i) && (!allow_lent || !migratable(i)))) {
+      len = 0;
+      start = i + 1;
+    } else if (++len == n) {
+      return start;
+    }
+  }
+  return -1;
+}
+
+// 把 [start, start+n) 中借出的页迁移走；返回0成功，否则返回第一个无法迁移的页号
+// 区间已在 used 中标记，不会再有页借出到这里
+static int reclaim_run(int start, int n, int *failed) {
+  for (int i = start; i < start + n; i++) {
+    acquire(&cma.lock);
+    int lent = TEST(cma.lent, i);
+    release(&cma.lock);
+    if (!lent)
+      continue;
+
+    void *old = cma_page(i);
+    void *new = kalloc_movable_nozero();
+    acquire(&pt_lock);
+    int ok = new != 0 && uvm_migrate(old, new) == 0;
+    release(&pt_lock);
+
+    acquire(&cma.lock);
+    if (ok || !TEST(cma.lent, i)) {
+      // 迁移成功，或者迁移期间持有者恰好释放了它
+      CLEAR(cma.lent, i);
+      cma.nlent--;
+      if (ok)
+        cma.migrated++;
+      kpage_set_private(old, 0);
+      release(&cma.lock);
+      if (!ok && new)
+        kfree(new);
+      continue;
+    }
+    release(&cma.lock);
+    if (new)
+      kfree(new);
+    *failed = i;
+    return -1;
+  }
+  return 0;
+}
+
+void *cma_alloc(int npages) {
+  if (npages <= 0 || npages > cma.npages)
+    return 0;
+
+  // 先找完全空闲的区间；没有时接受含借出页的区间并迁移
+  for (int pass = 0; pass < 2; pass++) {
+    int from = 0;
+    for (;;) {
+      acquire(&cma.lock);
+      int start = find_run(from, npages, pass);
+      if (start < 0) {
+        release(&cma.lock);
+        break;
+      }
+      for (int i = start; i < start + npages; i++)
+        SET(cma.used, i);
+      cma.nused += npages;
+      release(&cma.lock);
+
+      int failed;
+      if (pass == 0 || reclaim_run(start, npages, &failed) == 0) {
+        acquire(&cma.lock);
+        cma.allocs++;
+        release(&cma.lock);
+        void *pa = cma_page(start);
+        page_zero(pa, npages);
+        return pa;
+      }
+
+      // 回退占用标记，从无法迁移的页之后继续找
+      acquire(&cma.lock);
+      for (int i = start; i < start + npages; i++)
+        CLEAR(cma.used, i);
+      cma.nused -= npages;
+      release(&cma.lock);
+      from = failed + 1;
+    }
+  }
+
+  acquire(&cma.lock);
+  cma.failures++;
+  release(&cma.lock);
+  return 0;
+}
+
+void cma_free(void *pa, int npages) {
+  if (!cma_contains(pa) || ((uint64)pa % PGSIZE) != 0)
+    panic("cma_free: bad address");
+  int start = ((uint64)pa - cma.base) / PGSIZE;
+  if (start + npages > cma.npages)
+    panic("cma_free: bad size");
+
+  acquire(&cma.lock);
+  for (int i = start; i < start + npages; i++) {
+    if (!TEST(cma.used, i))
+      panic("cma_free: page not allocated");
+    CLEAR(cma.used, i);
+  }
+  cma.nused -= npages;
+  release(&cma.lock);
+}
+
+void *cma_lend(void) {
+  if (cma.npages == 0)
+    return 0;
+
+  acquire(&cma.lock);
+  for (int k = 0; k < cma.nwords; k++) {
+    int w = (cma.hint + k) % cma.nwords;
+    uint64 avail = ~(cma.used[w] | cma.lent[w]);
+    if (avail) {
+      int i = w * 64 + __builtin_ctzl(avail);
+      SET(cma.lent, i);
+      cma.nlent++;
+      cma.hint = w;
+      release(&cma.lock);
+      return cma_page(i);
+    }
+  }
+  release(&cma.lock);
+  return 0;
+}
+
+void cma_return(void *pa) {
+  int i = ((uint64)pa - cma.base) / PGSIZE;
+  acquire(&cma.lock);
+  if (TEST(cma.lent, i)) {
+    CLEAR(cma.lent, i);
+    cma.nlent--;
+  }
+  release(&cma.lock);
+}
+
+void cma_stats(struct cma_stats *st) {
+  acquire(&cma.lock);
+  st->base = cma.base;
+  st->npages = cma.npages;
+  st->used = cma.nused;
+  st->lent = cma.nlent;
+  st->allocs = cma.allocs;
+  st->failures = cma.failures;
+  st->migrated = cma.migrated;
+  release(&cma.lock);
+}
+
+void cma_dump(void) {
+  struct cma_stats st;
+  cma_stats(&st);
+  printf("=== Contiguous Region ===\n");
+  printf("base=%p pages=%d used=%d lent=%d allocs=%lu failures=%lu migrated=%lu\n",
+         (void *)st.base, st.npages, st.used, st.lent, st.allocs, st.failures, st.migrated);
+}
@@ -0,0 +1,73 @@
+#ifndef CMA_H
+#define CMA_H
+
+// 连续内存区（CMA）头文件
+// 启动时从伙伴系统之外划出一段物理连续内存，用位图按页管理：
+// 可以分配任意页数（不必是 2 的幂、可超过 4MB）的物理连续缓冲区；
+// 空闲时把页借给可移动的单页分配（kalloc_movable），需要连续内存时再把借出的页迁移走。
+
+#include "types.h"
+
+struct cma_stats {
+  uint64 base;      // 区域起始物理地址
+  int npages;       // 区域页数
+  int used;         // 被连续分配占用的页数
+  int lent;         // 借给可移动分配的页数
+  uint64 allocs;    // 连续分配成功次数
+  uint64 failures;  // 连续分配失败次数
+  uint64 migrated;  // 为连续分配迁移走的借出页数
+};
+
+/**
+ * 从设备树启动参数 "cma=<大小>[K|M|G]" 读取连续内存区大小，没有时使用 CMA_MB
+ * @return 页数
+ */
+int cma_configured_pages(void);
+
+/**
+ * 初始化连续内存区，由 kinit 在伙伴系统建立之后调用
+ * @param base 区域起始物理地址（页对齐），区域已从伙伴系统中排除
+ * @param npages 区域页数，0 表示不使用 CMA
+ */
+void cma_init(uint64 base, int npages);
+
+/**
+ * 判断 pa 是否位于连续内存区内
+ */
+int cma_contains(void *pa);
+
+/**
+ * 分配 npages 个物理连续页，内容已清零
+ * @return 成功返回起始地址，失败返回0
+ * @note 区间内借出的页会被迁移到伙伴系统的页上；被写时复制共享或没有反向映射的页无法迁移，
+ *       搜索时跳过包含它们的区间；每页迁移时持有 pt_lock，调用者不得持有它
+ */
+void *cma_alloc(int npages);
+
+/**
+ * 释放 cma_alloc 分配的连续页
+ */
+void cma_free(void *pa, int npages);
+
+/**
+ * 借出一个空闲页给可移动分配，内容未定义
+ * @return 成功返回页地址，区域已满或未启用时返回0
+ */
+void *cma_lend(void);
+
+/**
+ * 归还借出的页，由 kfree 在可移动页的最后一个引用释放时调用
+ */
+void cma_return(void *pa);
+
+/**
+ * 读取统计快照
+ */
+void cma_stats(struct cma_stats *st);
+
+/**
+ * 在控制台打印连续内存区的使用情况
+ */
+void cma_dump(void);
+
+#endif // CMA_H
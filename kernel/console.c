@@ -1,28 +1,140 @@
 #include "console.h"
 #include "uart.h"
 #include "printf.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "cpu.h"
+#include "string.h"
 
-
+// 输出环形缓冲区：console_putc 入队后立即返回，由 UART 发送空中断取出发送；
+// 调用者关着中断且不会再打开时（早期启动、从核）改为同步发送
+// head 为下一个写入位置，tail 为下一个待发送字符，head == tail 表示空
 console_buffer_t console_out_buf;
+static struct spinlock cons_lock;
+static int tx_busy;             // 已开启发送空中断，由中断继续发送
+static volatile int panicking;  // panic 后所有输出改为同步
+static uint64 tx_intrs;         // 已处理的发送空中断次数
+
+#define RING_NEXT(i) (((i) + 1) % CONSOLE_BUF_SIZE)
 
 // 初始化控制台（调用 UART 初始化）
 void console_init(void) {
+    initlock(&cons_lock, "console");
     uart_init();
     console_clear();
 }
 
-// 向控制台输出一个字符（通过 UART）
+// 把缓冲区中的字符写入 UART 发送 FIFO，需持有 cons_lock
+// FIFO 为空时一次最多写入 UART_FIFO_SIZE 个字符；缓冲区还有剩余则开启发送空中断
+static void console_start(void) {
+    if (uart_tx_ready()) {
+        for (int n = 0; n < UART_FIFO_SIZE && console_out_buf.tail != console_out_buf.head; n++) {
+            uart_tx(console_out_buf.buf[console_out_buf.tail]);
+            console_out_buf.tail = RING_NEXT(console_out_buf.tail);
+        }
+    }
+    tx_busy = console_out_buf.tail != console_out_buf.head;
+    uart_tx_intr(tx_busy);
+}
+
+// 发送空中断能否在本次输出之后到来，须在 acquire 之前调用
+// printf 总在 push_off 之内调用，所以看的是最外层 push_off 之前的中断状态：
+// 只关了这一层时以 intena 为准，pop_off 后中断即会打开
+static int console_async(void) {
+    if (intr_get())
+        return 1;
+    struct cpu *c = mycpu();
+    return c->noff == 1 && c->intena;
+}
+
+// 发送空中断不会到来时，同步发完缓冲区，需持有 cons_lock
+// 早期启动阶段的输出因此立即可见，不会滞留在缓冲区中直到开中断
+static void console_drain(void) {
+    while (console_out_buf.tail != console_out_buf.head) {
+        uart_putc(console_out_buf.buf[console_out_buf.tail]);
+        console_out_buf.tail = RING_NEXT(console_out_buf.tail);
+    }
+    tx_busy = 0;
+    uart_tx_intr(0);
+}
+
+// 向控制台输出一个字符：放入缓冲区后返回，只有缓冲区满时才等待
 void console_putc(char c) {
-    uart_putc(c);
+    if (panicking) {
+        uart_putc(c);
+        return;
+    }
+
+    int sync = !console_async();  // acquire 会关中断，须在此之前判断
+    acquire(&cons_lock);
+    // 缓冲区满：轮询 UART 腾出空间（此时可能关着中断，不能等待发送空中断）
+    while (RING_NEXT(console_out_buf.head) == console_out_buf.tail)
+        console_start();
+    console_out_buf.buf[console_out_buf.head] = c;
+    console_out_buf.head = RING_NEXT(console_out_buf.head);
+    // 发送已在进行时由中断接着发送，不必访问 UART
+    if (sync)
+        console_drain();
+    else if (!tx_busy)
+        console_start();
+    release(&cons_lock);
+}
+
+// 输出 n 个字符：一次获取 cons_lock 全部放入缓冲区，其他 hart 的输出不会插在中间
+void console_write(const char *s, int n) {
+    if (panicking) {
+        while (n-- > 0)
+            uart_putc(*s++);
+        return;
+    }
+
+    int sync = !console_async();
+    acquire(&cons_lock);
+    while (n-- > 0) {
+        while (RING_NEXT(console_out_buf.head) == console_out_buf.tail)
+            console_start();
+        console_out_buf.buf[console_out_buf.head] = *s++;
+        console_out_buf.head = RING_NEXT(console_out_buf.head);
+    }
+    if (sync)
+        console_drain();
+    else if (!tx_busy)
+        console_start();
+    release(&cons_lock);
+}
+
+// UART 发送空中断：继续发送缓冲区中的字符
+void console_tx_intr(void) {
+    acquire(&cons_lock);
+    tx_intrs++;
+    console_start();
+    release(&cons_lock);
+}
+
+// 已处理的发送空中断次数，供测试确认输出确实由中断驱动
+uint64 console_tx_intr_count(void) {
+    return __atomic_load_n(&tx_intrs, __ATOMIC_RELAXED);
+}
+
+// 是否还有字符留在缓冲区中等待发送
+int console_pending(void) {
+    return __atomic_load_n(&console_out_buf.tail, __ATOMIC_RELAXED) !=
+           __atomic_load_n(&console_out_buf.head, __ATOMIC_RELAXED);
+}
+
+// 进入 panic：此后输出全部同步发送，并先把缓冲区中尚未发出的字符发完
+// 不获取 cons_lock，panic 的 hart 可能正持有它
+void console_panic(void) {
+    panicking = 1;
+    uart_tx_intr(0);
+    console_flush();
 }
 
-// 向控制台输出一个字符串（通过 UART）
+// 向控制台输出一个字符串
 void console_puts(const char *s) {
     if (!s) return;  // 防止空指针
 
-    // 直接调用 uart_puts，但注意参数类型可能需要转换
-    // 假设 uart_puts 接受 char*，而 s 是 const char*
-    uart_puts((char *)s);
+    console_write(s, strlen(s));
 }
 
 // 清屏：发送 ANSI 清屏序列
@@ -39,6 +151,7 @@ void console_set_color(uint8_t fg_color, uint8_t bg_color) {
     console_puts(color_seq);
 }
 
+// 同步发送缓冲区中的全部字符
 void console_flush(void) {
     while (console_out_buf.tail != console_out_buf.head) {
         uart_putc(console_out_buf.buf[console_out_buf.tail]);
@@ -34,7 +34,13 @@ typedef struct {
 
 void console_init(void);
 void console_putc(char c);
+void console_flush(void);
+void console_tx_intr(void);
+uint64 console_tx_intr_count(void);
+int console_pending(void);
+void console_panic(void);
 void console_puts(const char *s);
+void console_write(const char *s, int n);
 void console_clear(void);
 void console_set_color(uint8_t fg_color, uint8_t bg_color);
 
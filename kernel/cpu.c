@@ -0,0 +1,16 @@
+// 每个 hart 的私有数据
+#include "types.h"
+#include "riscv.h"
+#include "cpu.h"
+
+struct cpu cpus[NCPU];
+
+// 当前 hart 的编号，tp 在 entry.S 中被设置为 hartid
+int cpuid(void) {
+  return r_tp();
+}
+
+// 当前 hart 的 cpu 结构
+struct cpu *mycpu(void) {
+  return &cpus[cpuid()];
+}
@@ -0,0 +1,23 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "types.h"
+#include "param.h"
+
+// 每个 hart 的私有数据
+// 以 hartid 为下标，hartid 由 entry.S 保存在 tp 寄存器中
+struct cpu {
+  int hartid;            // 硬件线程号
+  volatile int started;  // 本 hart 是否已完成初始化
+  int noff;              // push_off 嵌套深度
+  int intena;            // 第一次 push_off 之前中断是否开启
+  uint64 asid_ctx;       // 当前载入的地址空间的 ASID 上下文（代号 | ASID），内核页表为0
+  volatile int asid_flush; // ASID 回绕后，下次切换地址空间前须整体刷新 TLB
+};
+
+extern struct cpu cpus[NCPU];
+
+int cpuid(void);          // 当前 hart 的编号
+struct cpu *mycpu(void);  // 当前 hart 的 cpu 结构
+
+#endif
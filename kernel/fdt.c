@@ -0,0 +1,166 @@
+// 扁平设备树（FDT）解析
+// 只遍历一遍结构块：根节点的 memory 节点给出物理内存范围，
+// /reserved-memory 的子节点与内存保留表给出不能分配的区间，/chosen 给出启动参数。
+// FDT 中所有整数都是大端序。
+#include "types.h"
+#include "riscv.h"
+#include "memlayout.h"
+#include "string.h"
+#include "printf.h"
+#include "fdt.h"
+
+#define FDT_MAGIC      0xd00dfeed
+#define FDT_BEGIN_NODE 1
+#define FDT_END_NODE   2
+#define FDT_PROP       3
+#define FDT_NOP        4
+#define FDT_END        9
+#define FDT_MAX_DEPTH  16
+
+struct fdt_header {
+  uint32 magic;
+  uint32 totalsize;
+  uint32 off_dt_struct;
+  uint32 off_dt_strings;
+  uint32 off_mem_rsvmap;
+  uint32 version;
+  uint32 last_comp_version;
+  uint32 boot_cpuid_phys;
+  uint32 size_dt_strings;
+  uint32 size_dt_struct;
+};
+
+uint64 phystop = PHYSTOP_DEFAULT;
+struct memrange fdt_reserved[FDT_MAX_RESERVED];
+int fdt_nreserved;
+const char *fdt_bootargs;
+
+static uint32 be32(const void *p) {
+  const uint8 *b = (const uint8 *)p;
+  return ((uint32)b[0] << 24) | ((uint32)b[1] << 16) | ((uint32)b[2] << 8) | b[3];
+}
+
+// 读取 cells 个 32 位单元组成的数（1 或 2 个）
+static uint64 read_cells(const uint8 *p, int cells) {
+  uint64 v = 0;
+  for (int i = 0; i < cells; i++)
+    v = (v << 32) | be32(p + 4 * i);
+  return v;
+}
+
+static void add_reserved(uint64 start, uint64 size) {
+  if (size == 0)
+    return;
+  if (fdt_nreserved >= FDT_MAX_RESERVED) {
+    printf("fdt: too many reserved regions, ignoring %p\n", (void *)start);
+    return;
+  }
+  fdt_reserved[fdt_nreserved].start = PGROUNDDOWN(start);
+  fdt_reserved[fdt_nreserved].end = PGROUNDUP(start + size);
+  fdt_nreserved++;
+}
+
+// 节点名（去掉 @单元地址 后）是否等于 name
+static int node_is(const char *node, const char *name) {
+  while (*name && *node == *name) {
+    node++;
+    name++;
+  }
+  return *name == 0 && (*node == 0 || *node == '@');
+}
+
+int fdt_init(uint64 pa) {
+  const struct fdt_header *h = (const struct fdt_header *)pa;
+  if (pa == 0 || be32(&h->magic) != FDT_MAGIC) {
+    printf("fdt: no device tree, assuming RAM ends at %p\n", (void *)phystop);
+    return -1;
+  }
+
+  const uint8 *base = (const uint8 *)pa;
+  const uint8 *p = base + be32(&h->off_dt_struct);
+  const char *strings = (const char *)base + be32(&h->off_dt_strings);
+
+  // 设备树本身也要避开，之后仍可读取
+  add_reserved(pa, be32(&h->totalsize));
+
+  // 内存保留表：(地址, 大小) 对，以全0结束
+  for (const uint8 *r = base + be32(&h->off_mem_rsvmap);; r += 16) {
+    uint64 start = read_cells(r, 2), size = read_cells(r + 8, 2);
+    if (start == 0 && size == 0)
+      break;
+    add_reserved(start, size);
+  }
+
+  // 每层记录本节点声明的 #address-cells / #size-cells，供其子节点的 reg 使用
+  int addr_cells[FDT_MAX_DEPTH], size_cells[FDT_MAX_DEPTH];
+  int depth = -1;
+  int in_memory = 0, in_reserved = 0;  // 当前节点是 memory / reserved-memory 的子节点
+  const char *names[FDT_MAX_DEPTH];
+  uint64 ram_start = 0, ram_end = 0;
+
+  for (;;) {
+    uint32 tok = be32(p);
+    p += 4;
+    if (tok == FDT_BEGIN_NODE) {
+      const char *name = (const char *)p;
+      p += (strlen(name) + 1 + 3) & ~3;  // 节点名以0结尾并补齐到 4 字节
+      if (++depth >= FDT_MAX_DEPTH)
+        return -1;
+      names[depth] = name;
+      addr_cells[depth] = 2;  // 规范规定的默认值
+      size_cells[depth] = 1;
+      in_memory = depth == 1 && node_is(name, "memory");
+      in_reserved = depth == 2 && node_is(names[1], "reserved-memory");
+    } else if (tok == FDT_END_NODE) {
+      depth--;
+      in_memory = in_reserved = 0;
+      if (depth < 0)
+        break;
+    } else if (tok == FDT_PROP) {
+      uint32 len = be32(p);
+      const char *pname = strings + be32(p + 4);
+      const uint8 *val = p + 8;
+      p += 8 + ((len + 3) & ~3);
+      if (depth < 0)
+        continue;
+
+      if (node_is(pname, "#address-cells")) {
+        addr_cells[depth] = be32(val);
+      } else if (node_is(pname, "#size-cells")) {
+        size_cells[depth] = be32(val);
+      } else if (node_is(pname, "bootargs") && depth == 1 && node_is(names[1], "chosen")) {
+        fdt_bootargs = (const char *)val;  // 设备树保持保留，字符串之后仍可读取
+      } else if (node_is(pname, "reg") && depth > 0 && (in_memory || in_reserved)) {
+        int ac = addr_cells[depth - 1], sc = size_cells[depth - 1];
+        int step = 4 * (ac + sc);
+        for (const uint8 *r = val; r + step <= val + len; r += step) {
+          uint64 start = read_cells(r, ac), size = read_cells(r + 4 * ac, sc);
+          if (in_reserved) {
+            add_reserved(start, size);
+          } else if (start <= KERNBASE && KERNBASE < start + size) {
+            // 只使用包含内核的那一段内存，页号以 RAMBASE 为起点
+            ram_start = start;
+            ram_end = start + size;
+          }
+        }
+      }
+    } else if (tok == FDT_NOP) {
+      continue;
+    } else {
+      break;  // FDT_END 或无法识别的记号
+    }
+  }
+
+  if (ram_end == 0 || ram_start > RAMBASE) {
+    printf("fdt: no memory node containing the kernel, assuming RAM ends at %p\n", (void *)phystop);
+    return -1;
+  }
+  if (ram_end > PHYSTOP_MAX) {
+    printf("fdt: RAM above %p is not mapped\n", (void *)PHYSTOP_MAX);
+    ram_end = PHYSTOP_MAX;
+  }
+  phystop = PGROUNDDOWN(ram_end);
+  printf("fdt: RAM %p-%p (%d MB), %d reserved region(s)\n", (void *)ram_start, (void *)phystop,
+         (int)((phystop - ram_start) >> 20), fdt_nreserved);
+  return 0;
+}
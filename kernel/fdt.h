@@ -0,0 +1,30 @@
+#ifndef FDT_H
+#define FDT_H
+
+// 扁平设备树（FDT）解析头文件
+// OpenSBI 跳转到内核时在 a1 中传入设备树的物理地址，entry.S 将其保存在 boot_fdt 中。
+// 启动时只从中取出物理内存范围、必须避开的保留区与启动参数。
+
+#include "types.h"
+
+#define FDT_MAX_RESERVED 16  // 最多记录的保留区数量
+
+struct memrange {
+  uint64 start;
+  uint64 end;  // 不含
+};
+
+extern uint64 boot_fdt;                               // 设备树物理地址，定义在 entry.S
+extern struct memrange fdt_reserved[FDT_MAX_RESERVED]; // 不能交给分配器的区间（含设备树本身）
+extern int fdt_nreserved;
+extern const char *fdt_bootargs;                       // /chosen 的 bootargs，没有时为0
+
+/**
+ * 解析设备树，确定 phystop 与保留区
+ * @param pa 设备树的物理地址
+ * @return 成功返回0；设备树无效或没有包含内核的 memory 节点时返回-1，此时 phystop 保持默认值
+ * @note 必须在 kinit 之前调用；物理内存上限被截断为 PHYSTOP_MAX
+ */
+int fdt_init(uint64 pa);
+
+#endif // FDT_H
@@ -0,0 +1,83 @@
+// 延迟直方图
+// 每个 hart 各有一组直方图，记录时无需原子操作；只在打印时汇总。
+// 中断处理程序中的记录可能与被打断的记录竞争同一计数器，偶尔丢失一个样本可以接受。
+#include "types.h"
+#include "riscv.h"
+#include "param.h"
+#include "cpu.h"
+#include "hist.h"
+#include "printf.h"
+
+struct hist {
+  uint64 count;
+  uint64 max;
+  uint64 buckets[HIST_BUCKETS];
+};
+
+static struct hist hists[NCPU][NHIST];
+
+static const char *hist_names[NHIST] = {
+  "kalloc", "kfree", "walk", "mappages", "printf",
+};
+
+void hist_record(int probe, uint64 cycles) {
+  struct hist *h = &hists[cpuid()][probe];
+  int b = cycles ? 64 - __builtin_clzl(cycles) : 0;
+  if (b >= HIST_BUCKETS)
+    b = HIST_BUCKETS - 1;
+  h->buckets[b]++;
+  h->count++;
+  if (cycles > h->max)
+    h->max = cycles;
+}
+
+// 第 b 个桶的上界
+static uint64 bucket_limit(int b) {
+  return b == 0 ? 0 : (1UL << b) - 1;
+}
+
+// 累计样本数首次达到 count * pct / 100 的桶的上界，不超过最大值
+static uint64 percentile(struct hist *h, int pct) {
+  uint64 target = (h->count * pct + 99) / 100;
+  uint64 seen = 0;
+  for (int b = 0; b < HIST_BUCKETS; b++) {
+    seen += h->buckets[b];
+    if (seen >= target)
+      return bucket_limit(b) < h->max ? bucket_limit(b) : h->max;
+  }
+  return h->max;
+}
+
+void hist_dump(void) {
+  printf("=== Latency Histograms (cycles) ===\n");
+#ifndef CONFIG_HIST
+  printf("disabled at compile time (build with HIST=1)\n");
+#endif
+  for (int p = 0; p < NHIST; p++) {
+    struct hist sum = {0};
+    for (int c = 0; c < NCPU; c++) {
+      struct hist *h = &hists[c][p];
+      sum.count += h->count;
+      if (h->max > sum.max)
+        sum.max = h->max;
+      for (int b = 0; b < HIST_BUCKETS; b++)
+        sum.buckets[b] += h->buckets[b];
+    }
+    if (sum.count == 0)
+      continue;
+    printf("%s: count=%lu p50<=%lu p99<=%lu max=%lu\n", hist_names[p],
+           sum.count, percentile(&sum, 50), percentile(&sum, 99), sum.max);
+  }
+}
+
+void hist_reset(void) {
+  for (int c = 0; c < NCPU; c++) {
+    for (int p = 0; p < NHIST; p++) {
+      struct hist *h = &hists[c][p];
+      h->count = 0;
+      h->max = 0;
+      for (int b = 0; b < HIST_BUCKETS; b++)
+        h->buckets[b] = 0;
+    }
+  }
+}
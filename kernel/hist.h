@@ -0,0 +1,50 @@
+#ifndef HIST_H
+#define HIST_H
+
+// 延迟直方图头文件
+// 在热点函数入口与出口读取 cycle 计数器，按 2 的幂分桶记录耗时。
+// 编译时未定义 CONFIG_HIST（make HIST=0）时所有探针展开为空语句，没有任何开销。
+
+#include "types.h"
+#include "riscv.h"
+
+// 探针编号
+enum {
+  HIST_KALLOC,
+  HIST_KFREE,
+  HIST_WALK,
+  HIST_MAPPAGES,
+  HIST_PRINTF,
+  NHIST
+};
+
+// 第 i 个桶（i > 0）记录耗时在 [2^(i-1), 2^i) 个 cycle 内的样本，第 0 个桶记录耗时为 0 的样本
+#define HIST_BUCKETS 48
+
+#ifdef CONFIG_HIST
+#define HIST_BEGIN()     uint64 hist_t0_ = r_cycle()
+#define HIST_END(probe)  hist_record((probe), r_cycle() - hist_t0_)
+#else
+#define HIST_BEGIN()     do { } while (0)
+#define HIST_END(probe)  do { } while (0)
+#endif
+
+/**
+ * 记录一次样本，只写当前 hart 的直方图，不加锁
+ * @param probe 探针编号（HIST_*）
+ * @param cycles 耗时（cycle）
+ */
+void hist_record(int probe, uint64 cycles);
+
+/**
+ * 汇总所有 hart 的直方图，打印每个探针的样本数、p50、p99 与最大值
+ * @note p50 / p99 按所在桶的上界给出
+ */
+void hist_dump(void);
+
+/**
+ * 清空所有直方图
+ */
+void hist_reset(void);
+
+#endif // HIST_H
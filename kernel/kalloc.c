@@ -4,35 +4,98 @@
 #include "kalloc.h"
 #include "printf.h"
 #include "string.h"
+#include "spinlock.h"
+#include "param.h"
+#include "cpu.h"
+#include "hist.h"
+#include "pageops.h"
+#include "fdt.h"
+#include "cma.h"
+#include "vm.h"
 
 extern char end[]; // 内核代码结束位置
 
-#define MAX_ORDER 10  // 最大阶数 2^10 * 4KB = 4MB
-#define RUN_BASE ((uint64)end)
-#define RUN_TOP  PHYSTOP
+#define MAX_ORDER KALLOC_MAX_ORDER
+// 每页元数据，按页号（相对于 RAMBASE）索引
+// 数组大小取决于设备树给出的物理内存大小，kinit 从 end 之后的空闲内存中分配
+// page_orders 记录页面分配出去后是几阶的，以便 free 时合并
+uint8_t *page_orders;
 
-// 计算总页数 (128MB / 4KB = 32768页)
-// 这里的数组用于在页面分配出去后，记录它是几阶的，以便free时合并
-// 这是一个简单的外部元数据管理方案
-#define MAX_PAGES ((PHYSTOP - 0x80000000) / PGSIZE) 
-uint8_t page_orders[MAX_PAGES]; 
+// 每页状态标志，只在块的首页上有意义
+// PG_FREE 表示该页是空闲链表中某个块的首页，配合 page_orders 可 O(1) 判断伙伴是否可合并
+// PG_LIST_UNMOVABLE 记录空闲块位于哪一类链表，页块类型改变后仍能从正确的链表摘除
+// PG_MOVABLE 表示已分配的单页可以迁移（用户数据页，页私有字是映射它的 PTE）
+// PG_CACHED 表示单页位于某个 hart 的单页缓存或预清零页池中，用于发现对缓存页的重复释放
+#define PG_FREE           0x01
+#define PG_LIST_UNMOVABLE 0x02
+#define PG_MOVABLE        0x04
+#define PG_CACHED         0x08
+uint8_t *page_flags;
 
+// 每个页块（2^PAGEBLOCK_ORDER 页，与 2MB 大页相同）的迁移类型，按页号 >> PAGEBLOCK_ORDER 索引
+// 同类分配集中在同类页块中，不可迁移的页就不会散布到整个内存，可迁移页则能通过规整腾出高阶块
+uint8_t *pageblock_types;
+static uint64 nr_pages;  // 元数据覆盖的页数
+
+// 每页私有字，由分配到该页的上层使用者自行解释（例如 slab 记录所属 slab 首部）
+uint64 *page_private;
+
+// 已分配块的额外引用数（写时复制共享时增加），只在块的首页上有意义
+// 默认0表示只有一个持有者，分配路径无需初始化；kfree 在引用数非0时只减引用
+uint32 *page_refs;
+
+// 空闲块链表节点（双向链表，支持 O(1) 摘除任意块）
 struct run {
   struct run *next;
+  struct run *prev;
 };
 
+// 伙伴系统全局状态，由 lock 保护（包括空闲块的 page_orders / page_flags）
 struct {
-  struct run *freelists[MAX_ORDER + 1]; // 0~10阶的空闲链表
+  struct spinlock lock;
+  struct run *freelists[MAX_ORDER + 1][MIGRATE_TYPES]; // 0~10阶、按迁移类型分开的空闲链表
+  struct kalloc_order_stats stats[MAX_ORDER + 1];
+  uint64 total_pages;
+  uint64 free_pages;
+  uint64 peak_pages;   // total - free 的历史最大值
+  uint64 compact_runs;
+  uint64 compact_success;
+  uint64 compact_migrated;
+  uint32 compact_considered[MAX_ORDER + 1];   // 推迟期间已跳过的规整次数
+  uint32 compact_defer_shift[MAX_ORDER + 1];  // 推迟 2^shift 次
 } kmem;
 
-// 辅助函数：物理地址转页号（相对于0x80000000）
+// 反碎片机制的开关，供对比测试在运行时切换
+static int grouping = 1;    // 按迁移类型分组
+static int compaction = 1;  // 高阶分配失败时规整
+
+// 每个 hart 的单页缓存（magazine），位于伙伴系统之前
+// 单页分配/释放只访问本 hart 的缓存，关中断即可，无需获取 kmem.lock；
+// 缓存为空时一次性从伙伴系统补充到低水位，超过高水位时一次性归还到低水位
+#define MAG_CAPACITY   256  // 单页缓存容量上限
+#define MAG_LOW_DEF    16   // 默认低水位
+#define MAG_HIGH_DEF   64   // 默认高水位
+#define ZERO_POOL_SIZE 64   // 每个 hart 的预清零页池容量
+
+struct magazine {
+  void *pages[MAG_CAPACITY];     // 未清零的单页
+  int count;
+  void *zeroed[ZERO_POOL_SIZE];  // 预清零页池：空闲循环中提前清零，kalloc 优先从这里取
+  int nzeroed;
+};
+
+struct magazine mags[NCPU];
+static int mag_low = MAG_LOW_DEF;
+static int mag_high = MAG_HIGH_DEF;
+
+// 辅助函数：物理地址转页号（相对于 RAMBASE）
 int pa2idx(uint64 pa) {
-  return (pa - 0x80000000) / PGSIZE;
+  return (pa - RAMBASE) / PGSIZE;
 }
 
 // 辅助函数：页号转物理地址
 uint64 idx2pa(int idx) {
-  return 0x80000000 + (uint64)idx * PGSIZE;
+  return RAMBASE + (uint64)idx * PGSIZE;
 }
 
 // 获取 buddy 的物理地址
@@ -41,103 +104,255 @@ uint64 get_buddy(uint64 pa, int order) {
   return pa ^ size; // 异或操作找到伙伴
 }
 
+static int pageblock_type(uint64 pa) {
+  return pageblock_types[pa2idx(pa) >> PAGEBLOCK_ORDER];
+}
+
+// 将首地址为 pa 的 order 阶块插入空闲链表头部，并标记为空闲
+// 块进入其所在页块类型的链表；关闭分组时都进入可迁移链表
+static void freelist_push(uint64 pa, int order) {
+  int mt = grouping ? pageblock_type(pa) : MIGRATE_MOVABLE;
+  struct run *r = (struct run *)pa;
+  r->prev = 0;
+  r->next = kmem.freelists[order][mt];
+  if (r->next)
+    r->next->prev = r;
+  kmem.freelists[order][mt] = r;
+  kmem.stats[order].free_blocks++;
+  kmem.free_pages += 1UL << order;
+
+  int idx = pa2idx(pa);
+  page_orders[idx] = order;
+  page_flags[idx] |= PG_FREE;
+  if (mt == MIGRATE_UNMOVABLE)
+    page_flags[idx] |= PG_LIST_UNMOVABLE;
+}
+
+// 将块 r 从 order 阶空闲链表中摘除，并清除空闲标记
+static void freelist_remove(struct run *r, int order) {
+  int idx = pa2idx((uint64)r);
+  int mt = (page_flags[idx] & PG_LIST_UNMOVABLE) ? MIGRATE_UNMOVABLE : MIGRATE_MOVABLE;
+  if (r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.freelists[order][mt] = r->next;
+  if (r->next)
+    r->next->prev = r->prev;
+  kmem.stats[order].free_blocks--;
+  kmem.free_pages -= 1UL << order;
+
+  page_flags[idx] &= ~(PG_FREE | PG_LIST_UNMOVABLE);
+}
+
+// 将 [start, stop) 直接切分为尽可能大的自然对齐块插入空闲链表
+// 相比逐页 kfree，这里每个块只做一次 O(1) 插入，且切分结果不存在可合并的伙伴对
+static void buddy_add_range(uint64 start, uint64 stop) {
+  uint64 pa = PGROUNDUP(start);
+  while (pa + PGSIZE <= stop) {
+    int order = MAX_ORDER;
+    // 找到起始地址对齐且不越界的最大阶
+    while (order > 0 &&
+           ((pa & ((PGSIZE << order) - 1)) != 0 || pa + (PGSIZE << order) > stop))
+      order--;
+    freelist_push(pa, order);
+    kmem.total_pages += 1UL << order;
+    pa += PGSIZE << order;
+  }
+}
+
+// 不能交给伙伴系统的区间：设备树报告的保留区，再加上页元数据与连续内存区
+static struct memrange excluded[FDT_MAX_RESERVED + 2];
+static int nexcluded;
+
+static void exclude(uint64 start, uint64 size) {
+  excluded[nexcluded].start = start;
+  excluded[nexcluded].end = PGROUNDUP(start + size);
+  nexcluded++;
+}
+
+// 将 [start, stop) 去掉第 i 个及之后的排除区间后加入伙伴系统
+static void add_usable(uint64 start, uint64 stop, int i) {
+  for (; i < nexcluded && start < stop; i++) {
+    struct memrange *r = &excluded[i];
+    if (r->end <= start || r->start >= stop)
+      continue;
+    if (r->start > start)
+      add_usable(start, r->start, i + 1);
+    start = r->end;
+  }
+  if (start < stop)
+    buddy_add_range(start, stop);
+}
+
+// 在 end 之后找一段不与已排除区间重叠、能放下 size 字节的区间，找不到返回0
+static uint64 find_gap(uint64 size) {
+  uint64 a = PGROUNDUP((uint64)end);
+  for (int i = 0; i < nexcluded; i++) {
+    struct memrange *r = &excluded[i];
+    if (r->start < a + size && a < r->end) {
+      a = r->end;
+      i = -1;  // 移动后重新检查所有区间
+    }
+  }
+  if (a + size > PHYSTOP)
+    return 0;
+  return a;
+}
+
 void kinit() {
+  initlock(&kmem.lock, "kmem");
+
   // 1. 初始化所有链表
   for(int i = 0; i <= MAX_ORDER; i++) {
-    kmem.freelists[i] = 0;
+    for (int mt = 0; mt < MIGRATE_TYPES; mt++)
+      kmem.freelists[i][mt] = 0;
   }
 
-  // 2. 初始化 page_orders 数组
-  memset(page_orders, 0, sizeof(page_orders));
+  // 2. 按物理内存大小分配并清零每页元数据（按对齐要求从大到小排列）
+  //    页块类型清零后都是 MIGRATE_MOVABLE，不可迁移的分配按需占用页块
+  for (int i = 0; i < fdt_nreserved; i++)
+    excluded[i] = fdt_reserved[i];
+  nexcluded = fdt_nreserved;
+
+  uint64 npages = (PHYSTOP - RAMBASE) / PGSIZE;
+  uint64 nblocks = (npages >> PAGEBLOCK_ORDER) + 1;
+  uint64 size = npages * (sizeof(uint64) + sizeof(uint32) + 2 * sizeof(uint8_t)) + nblocks;
+  uint64 meta = find_gap(size);
+  if (meta == 0)
+    panic("kinit: no room for page metadata");
+  page_private = (uint64 *)meta;
+  page_refs = (uint32 *)(page_private + npages);
+  page_orders = (uint8_t *)(page_refs + npages);
+  page_flags = page_orders + npages;
+  pageblock_types = page_flags + npages;
+  nr_pages = npages;
+  memset((void *)meta, 0, size);
+  exclude(meta, size);
+
+  // 3. 划出连续内存区，它不进入伙伴系统，由 cma.c 单独管理
+  int cma_pages = cma_configured_pages();
+  uint64 cma_base = cma_pages > 0 ? find_gap((uint64)cma_pages * PGSIZE) : 0;
+  if (cma_pages > 0 && cma_base == 0) {
+    printf("kinit: no room for a %d KB contiguous region\n", cma_pages * (PGSIZE / 1024));
+    cma_pages = 0;
+  }
+  if (cma_pages > 0)
+    exclude(cma_base, (uint64)cma_pages * PGSIZE);
 
-  // 3. 将可用内存范围加入伙伴系统
-  // 为了简化，我们按页逐个释放到系统中，让 buddy_free 自动合并它们
+  // 4. 将可用内存范围去掉排除区间后按最大对齐块批量加入伙伴系统
   char *p = (char*)PGROUNDUP((uint64)end);
-  printf("kinit: initializing buddy system from %p to %p\n", p, (void*)PHYSTOP);
-  
-  for(; p + PGSIZE <= (char*)PHYSTOP; p += PGSIZE) {
-    kfree(p); 
+  printf("kinit: initializing buddy system from %p to %p, %d KB page metadata at %p\n",
+         p, (void*)PHYSTOP, (int)(size >> 10), (void *)meta);
+  add_usable((uint64)p, PHYSTOP, 0);
+
+  // 5. 连续内存区的位图从伙伴系统中分配
+  cma_init(cma_base, cma_pages);
+}
+
+// 把 r 从空闲链表取出并拆分到 order 阶，调用者须持有 kmem.lock
+static void *take_block(struct run *r, int cur_order, int order) {
+  freelist_remove(r, cur_order);
+  uint64 pa = (uint64)r;
+
+  // 如果块太大，进行分裂
+  while (cur_order > order) {
+    kmem.stats[cur_order].splits++;
+    cur_order--;
+    // 将分裂出来的伙伴块加入低一级的空闲链表（同时记录其 order 与空闲标记）
+    freelist_push(get_buddy(pa, cur_order), cur_order);
   }
+
+  // 记录分配出去的块的 order，供 kfree 使用
+  page_orders[pa2idx(pa)] = order;
+  kmem.stats[order].allocs++;
+  if (kmem.total_pages - kmem.free_pages > kmem.peak_pages)
+    kmem.peak_pages = kmem.total_pages - kmem.free_pages;
+
+  // 返回 (必须返回对齐的地址！)，不负责清零，由上层接口决定
+  return (void*)pa;
 }
 
-// 核心分配函数
-void *buddy_alloc(int order) {
-  int cur_order;
-  
-  // 1. 寻找足够大的最小空闲块
-  for (cur_order = order; cur_order <= MAX_ORDER; cur_order++) {
-    if (kmem.freelists[cur_order]) {
-      // 2. 找到块，从链表移除
-      struct run *r = kmem.freelists[cur_order];
-      kmem.freelists[cur_order] = r->next;
-      
-      uint64 pa = (uint64)r;
-
-      // 3. 如果块太大，进行分裂
-      while (cur_order > order) {
-        cur_order--;
-        uint64 buddy_pa = get_buddy(pa, cur_order);
-        struct run *buddy_r = (struct run *)buddy_pa;
-        
-        // 将分裂出来的伙伴块加入低一级的空闲链表
-        buddy_r->next = kmem.freelists[cur_order];
-        kmem.freelists[cur_order] = buddy_r;
-        
-        // 记录伙伴块的 order (虽然它在空闲链表中，但也标记一下以防万一)
-        page_orders[pa2idx(buddy_pa)] = cur_order;
-      }
-      
-      // 4. 记录分配出去的块的 order，供 kfree 使用
-      page_orders[pa2idx(pa)] = order;
-      
-      // 5. 清零并返回 (必须返回对齐的地址！)
-      memset((void*)pa, 0, (1 << order) * PGSIZE);
-      return (void*)pa;
+// 把 pa 所在的页块（order 阶块跨越多个页块时为全部）改为 mt 类型，并把其中的空闲块移到对应链表
+// 页块内的块首页可以从页块起点沿 page_orders 逐块找到
+static void claim_pageblocks(uint64 pa, int order, int mt) {
+  int shift = order > PAGEBLOCK_ORDER ? order : PAGEBLOCK_ORDER;
+  uint64 start = pa & ~((PGSIZE << shift) - 1);
+  uint64 stop = start + (PGSIZE << shift);
+  for (uint64 a = start; a < stop; a += PGSIZE << PAGEBLOCK_ORDER)
+    pageblock_types[pa2idx(a) >> PAGEBLOCK_ORDER] = mt;
+
+  for (uint64 a = start; a < stop && a < PHYSTOP;) {
+    int idx = pa2idx(a);
+    int o = page_orders[idx];
+    if (page_flags[idx] & PG_FREE) {
+      freelist_remove((struct run *)a, o);
+      freelist_push(a, o);
     }
+    a += PGSIZE << o;
   }
-  
-  return 0; // 内存不足
 }
 
-// 核心释放函数
-void buddy_free(void *pa) {
-  uint64 block_pa = (uint64)pa;
-  
-  // 简单的范围检查
-  if(block_pa < (uint64)end || block_pa >= PHYSTOP) 
-    return;
+// 从伙伴系统中取出一个 order 阶、mt 类型的块，调用者须持有 kmem.lock
+static void *alloc_block(int order, int mt) {
+  if (!grouping)
+    mt = MIGRATE_MOVABLE;
+  int other = MIGRATE_TYPES - 1 - mt;
+
+  // 1. 在本类型的链表中寻找足够大的最小空闲块
+  for (int cur_order = order; cur_order <= MAX_ORDER; cur_order++) {
+    if (kmem.freelists[cur_order][mt])
+      return take_block(kmem.freelists[cur_order][mt], cur_order, order);
+  }
+
+  // 2. 本类型没有合适的块时从另一类型借用，取最大的块以减少以后的借用次数；
+  //    为不可迁移分配借用，或借用的块较大时，把整个页块改为本类型，使同类分配聚在一起
+  for (int cur_order = MAX_ORDER; cur_order >= order; cur_order--) {
+    struct run *r = kmem.freelists[cur_order][other];
+    if (r == 0)
+      continue;
+    if (grouping && (mt == MIGRATE_UNMOVABLE || cur_order >= PAGEBLOCK_ORDER / 2))
+      claim_pageblocks((uint64)r, cur_order, mt);
+    return take_block(r, cur_order, order);
+  }
+
+  return 0; // 内存不足，失败次数由调用者在放弃时统计
+}
+
+// 检查 pa 是否位于某个空闲块内：包含它的空闲块首页必然是 pa 按某一阶对齐后的地址，O(MAX_ORDER)
+// 已与伙伴合并的块首页不再带 PG_FREE，只查首页无法发现这种重复释放
+static int in_free_block(uint64 pa) {
+  for (int o = 0; o <= MAX_ORDER; o++) {
+    uint64 head = pa & ~((PGSIZE << o) - 1);
+    if (head < RAMBASE)
+      break;
+    int idx = pa2idx(head);
+    if ((page_flags[idx] & PG_FREE) && head + (PGSIZE << page_orders[idx]) > pa)
+      return 1;
+  }
+  return 0;
+}
 
+// 把块放回空闲链表并尽量与伙伴合并，不计入释放次数，调用者须持有 kmem.lock
+// 规整回退时放回的块不是调用者释放的，直接经由这里
+static void merge_block(uint64 block_pa) {
   int idx = pa2idx(block_pa);
   int order = page_orders[idx]; // 获取该块的大小
+  page_flags[idx] &= ~PG_MOVABLE;
 
-  // 尝试合并
+  // 尝试合并：每一阶只需 O(1) 查询伙伴首页的标志，整体 O(MAX_ORDER)
   while (order < MAX_ORDER) {
     uint64 buddy_pa = get_buddy(block_pa, order);
     
-    // --- 修复：删除了未使用的 buddy_idx 变量 ---
-    
     // 检查伙伴是否越界
     if (buddy_pa < (uint64)end || buddy_pa >= PHYSTOP) break;
 
-    // 检查伙伴是否空闲
-    struct run **pprev = &kmem.freelists[order];
-    struct run *curr = *pprev;
-    int found_buddy = 0;
-
-    while(curr) {
-      if((uint64)curr == buddy_pa) {
-        // 找到伙伴，将其从链表移除
-        *pprev = curr->next;
-        found_buddy = 1;
-        break;
-      }
-      pprev = &curr->next;
-      curr = *pprev;
-    }
-
-    if (!found_buddy) {
+    // 伙伴必须是空闲块的首页，且恰好为同阶，才能合并
+    int buddy_idx = pa2idx(buddy_pa);
+    if (!(page_flags[buddy_idx] & PG_FREE) || page_orders[buddy_idx] != order) {
       break; // 伙伴已分配或拆分，无法合并
     }
+    freelist_remove((struct run *)buddy_pa, order);
+    kmem.stats[order].merges++;
 
     // 合并：取地址较小者作为新块
     if (buddy_pa < block_pa) {
@@ -146,24 +361,518 @@ void buddy_free(void *pa) {
     order++;
   }
 
-  // 将最终的块加入对应的空闲链表
-  struct run *r = (struct run*)block_pa;
-  r->next = kmem.freelists[order];
-  kmem.freelists[order] = r;
-  
-  // 更新该块的 order
-  page_orders[pa2idx(block_pa)] = order;
+  // 整个页块都已空闲，其中不再有不可迁移的页，恢复为默认的可迁移类型
+  for (int i = 0; order >= PAGEBLOCK_ORDER && i < 1 << (order - PAGEBLOCK_ORDER); i++)
+    pageblock_types[(pa2idx(block_pa) >> PAGEBLOCK_ORDER) + i] = MIGRATE_MOVABLE;
+
+  // 将最终的块加入对应的空闲链表（同时更新该块的 order 与空闲标记）
+  freelist_push(block_pa, order);
+}
+
+// 将块归还伙伴系统并尽量合并，调用者须持有 kmem.lock
+static void free_block(uint64 block_pa) {
+  if (in_free_block(block_pa))
+    return; // 重复释放（包括已经合并进更大空闲块的情况），忽略
+  kmem.stats[page_orders[pa2idx(block_pa)]].frees++;
+  merge_block(block_pa);
+}
+
+// 检查 pa 是否为可归还伙伴系统的页地址
+static int valid_pa(uint64 pa) {
+  return pa >= (uint64)end && pa < PHYSTOP && (pa % PGSIZE) == 0;
+}
+
+// 页能否被规整迁移：已分配的单页、标记为可迁移、有反向映射且没有被共享
+static int page_migratable(int idx) {
+  return !(page_flags[idx] & PG_FREE) && page_orders[idx] == 0 && (page_flags[idx] & PG_MOVABLE) &&
+         page_private[idx] != 0 && page_refs[idx] == 0;
+}
+
+// 规整是否值得尝试：参照 Linux 的外部碎片指数，空闲块总数相对于空闲页数越多，
+// 失败越可能是碎片而不是内存不足所致；指数不超过阈值时规整腾不出块，O(MAX_ORDER)
+static int compact_suitable(int order) {
+  uint64 blocks = 0;
+  for (int o = 0; o <= MAX_ORDER; o++)
+    blocks += kmem.stats[o].free_blocks;
+  if (kmem.free_pages < (1UL << order) || blocks == 0)
+    return 0;
+  uint64 index = 1000 - (1000 + kmem.free_pages * 1000 / (1UL << order)) / blocks;
+  return index > COMPACT_FRAG_THRESHOLD;
+}
+
+// 按 Linux 的 defer_compaction：某阶规整失败后跳过随后 2^shift 次尝试，成功后清零
+static int compact_deferred(int order) {
+  if (++kmem.compact_considered[order] < 1U << kmem.compact_defer_shift[order])
+    return 1;
+  kmem.compact_considered[order] = 0;
+  return 0;
+}
+
+static void compact_result(int order, int ok) {
+  kmem.compact_considered[order] = 0;
+  if (ok)
+    kmem.compact_defer_shift[order] = 0;
+  else if (kmem.compact_defer_shift[order] < COMPACT_MAX_DEFER_SHIFT)
+    kmem.compact_defer_shift[order]++;
+}
+
+// 尝试腾空从 start 开始的 2^order 页窗口，最多迁移 *budget 页；成功时窗口归调用者所有
+// 先把窗口内的空闲块摘出链表，迁移目标就不会落回窗口内；失败时把已腾出的部分放回伙伴系统
+static int compact_window(uint64 start, int order, int *budget) {
+  uint64 stop = start + ((uint64)PGSIZE << order);
+
+  // 1. 之前的尝试分配了迁移目标或放回了页，重新确认窗口内只有空闲块和可迁移页
+  //    （窗口起点已落在更大的空闲块内部时，沿 page_orders 找不到块首页，直接放弃）
+  int head = pa2idx(start);
+  if (in_free_block(start) && !((page_flags[head] & PG_FREE) && page_orders[head] <= order))
+    return 0;
+  int cost = 0;
+  for (uint64 a = start; a < stop; a += PGSIZE << page_orders[pa2idx(a)]) {
+    int idx = pa2idx(a);
+    if (page_flags[idx] & PG_FREE)
+      continue;
+    if (!page_migratable(idx))
+      return 0;
+    cost++;
+  }
+  if (cost > *budget)
+    return 0;
+
+  // 2. 摘出窗口内的空闲块
+  for (uint64 a = start; a < stop; a += PGSIZE << page_orders[pa2idx(a)]) {
+    if (page_flags[pa2idx(a)] & PG_FREE)
+      freelist_remove((struct run *)a, page_orders[pa2idx(a)]);
+  }
+
+  // 3. 逐页迁移，新页从窗口外分配；旧页的分配就此结束，计入 0 阶释放
+  uint64 a;
+  for (a = start; a < stop; a += PGSIZE << page_orders[pa2idx(a)]) {
+    int idx = pa2idx(a);
+    if (!(page_flags[idx] & PG_MOVABLE))
+      continue; // 已摘出的空闲块
+    void *new = alloc_block(0, MIGRATE_MOVABLE);
+    if (new == 0)
+      break;
+    if (uvm_migrate((void *)a, new) != 0) {
+      free_block((uint64)new);
+      break;
+    }
+    page_flags[pa2idx((uint64)new)] |= PG_MOVABLE;
+    page_flags[idx] &= ~PG_MOVABLE;
+    kmem.stats[0].frees++;
+    kmem.compact_migrated++;
+    (*budget)--;
+  }
+  if (a >= stop)
+    return 1;
+
+  // 4. 回退：摘出的空闲块与已迁移走的旧页放回伙伴系统
+  for (uint64 b = start; b < stop; ) {
+    int idx = pa2idx(b), o = page_orders[idx];
+    if (!(page_flags[idx] & PG_MOVABLE))
+      merge_block(b);
+    b += PGSIZE << o;
+  }
+  return 0;
+}
+
+// 规整：为 order 阶分配腾出一个对齐块，调用者须持有 pt_lock 与 kmem.lock（因而关着中断）
+// 沿块首页扫描一遍页元数据，记下需要迁移页数最少的 COMPACT_MAX_TRIES 个候选窗口，
+// 窗口内有不可迁移的页（页表、内核对象、保留区、没有反向映射的页）则不能作为候选；
+// 依次尝试，某个窗口中途有页无法迁移时换下一个，全部尝试合计最多迁移 COMPACT_MAX_MIGRATE 页
+static void *compact_block(int order) {
+  if (!compact_suitable(order) || compact_deferred(order))
+    return 0;
+  kmem.compact_runs++;
+
+  // 1. 选择候选窗口，按迁移页数从少到多排列
+  int n = 1 << order;
+  int cand[COMPACT_MAX_TRIES], cost_of[COMPACT_MAX_TRIES], ncand = 0;
+  int w = 0, cost = 0, ok = 0;
+  for (int i = 0; i < (int)nr_pages;) {
+    if (i % n == 0) {
+      w = i;
+      cost = 0;
+      ok = 1;
+    }
+    int o = page_orders[i];
+    if (page_flags[i] & PG_FREE)
+      ;
+    else if (page_migratable(i))
+      cost++;
+    else
+      ok = 0; // 不可迁移或多页的已分配块，以及不归伙伴系统管理的页
+    i += 1 << o;
+    if (i >= w + n) {
+      if (ok && cost <= COMPACT_MAX_MIGRATE && w + n <= (int)nr_pages &&
+          (ncand < COMPACT_MAX_TRIES || cost < cost_of[ncand - 1])) {
+        int j = ncand < COMPACT_MAX_TRIES ? ncand++ : ncand - 1;
+        for (; j > 0 && cost_of[j - 1] > cost; j--) {
+          cand[j] = cand[j - 1];
+          cost_of[j] = cost_of[j - 1];
+        }
+        cand[j] = w;
+        cost_of[j] = cost;
+      }
+      ok = 0;
+    }
+  }
+
+  // 2. 依次尝试
+  int budget = COMPACT_MAX_MIGRATE;
+  for (int k = 0; k < ncand; k++) {
+    uint64 start = idx2pa(cand[k]);
+    if (!compact_window(start, order, &budget))
+      continue;
+
+    // 整个窗口交给不可迁移的调用者，所在页块也归入不可迁移类型
+    page_orders[cand[k]] = order;
+    if (grouping)
+      claim_pageblocks(start, order, MIGRATE_UNMOVABLE);
+    kmem.stats[order].allocs++;
+    if (kmem.total_pages - kmem.free_pages > kmem.peak_pages)
+      kmem.peak_pages = kmem.total_pages - kmem.free_pages;
+    kmem.compact_success++;
+    compact_result(order, 1);
+    return (void *)start;
+  }
+  compact_result(order, 0);
+  return 0;
+}
+
+// 核心分配函数：不可迁移的块，失败时尝试规整
+// 迁移须持有锁序在前的 pt_lock，规整前先放开 kmem.lock，按序重新获取后再试一次分配
+void *buddy_alloc(int order) {
+  if (order < 0 || order > MAX_ORDER)
+    return 0;
+  acquire(&kmem.lock);
+  void *pa = alloc_block(order, MIGRATE_UNMOVABLE);
+  if (pa == 0 && order > 0 && compaction) {
+    release(&kmem.lock);
+    acquire(&pt_lock);
+    acquire(&kmem.lock);
+    pa = alloc_block(order, MIGRATE_UNMOVABLE);
+    if (pa == 0)
+      pa = compact_block(order);
+    if (pa == 0)
+      kmem.stats[order].failures++;
+    release(&kmem.lock);
+    release(&pt_lock);
+    return pa;
+  }
+  if (pa == 0)
+    kmem.stats[order].failures++;
+  release(&kmem.lock);
+  return pa;
+}
+
+// 核心释放函数
+void buddy_free(void *pa) {
+  // 简单的范围与对齐检查
+  if (!valid_pa((uint64)pa))
+    return;
+
+  acquire(&kmem.lock);
+  free_block((uint64)pa);
+  release(&kmem.lock);
 }
 
-// 适配接口：分配一页
+// 从伙伴系统批量补充单页缓存到低水位，只获取一次 kmem.lock
+static void mag_refill(struct magazine *m) {
+  acquire(&kmem.lock);
+  while (m->count < mag_low) {
+    void *pa = alloc_block(0, MIGRATE_UNMOVABLE);
+    if (pa == 0) {
+      kmem.stats[0].failures++;
+      break;
+    }
+    page_flags[pa2idx((uint64)pa)] |= PG_CACHED;
+    m->pages[m->count++] = pa;
+  }
+  release(&kmem.lock);
+}
+
+// 把离开缓存的单页还给伙伴系统，调用者须持有 kmem.lock
+static void mag_release(void *pa) {
+  page_flags[pa2idx((uint64)pa)] &= ~PG_CACHED;
+  free_block((uint64)pa);
+}
+
+// 从缓存中取出一页交给调用者
+static void *mag_take(void *pa) {
+  page_flags[pa2idx((uint64)pa)] &= ~PG_CACHED;
+  return pa;
+}
+
+// 将单页缓存批量归还伙伴系统直到只剩 keep 页，只获取一次 kmem.lock
+static void mag_drain(struct magazine *m, int keep) {
+  acquire(&kmem.lock);
+  while (m->count > keep)
+    mag_release(m->pages[--m->count]);
+  release(&kmem.lock);
+}
+
+// 从本 hart 的单页缓存取一页（内容未定义），调用者须已 push_off
+// use_zeroed 为真时，缓存和伙伴系统都耗尽后退而使用预清零页
+static void *mag_get(struct magazine *m, int use_zeroed) {
+  if (m->count == 0)
+    mag_refill(m);
+  if (m->count > 0)
+    return mag_take(m->pages[--m->count]);
+  if (use_zeroed && m->nzeroed > 0)
+    return mag_take(m->zeroed[--m->nzeroed]);
+  return 0;
+}
+
+// 适配接口：分配一页（已清零）
+// 优先使用本 hart 的预清零页池，池空时才在分配路径上清零
 void *kalloc(void) {
-  return buddy_alloc(0);
+  HIST_BEGIN();
+  push_off();
+  struct magazine *m = &mags[cpuid()];
+  void *pa;
+  if (m->nzeroed > 0)
+    pa = mag_take(m->zeroed[--m->nzeroed]);
+  else if ((pa = mag_get(m, 0)) != 0)
+    page_zero(pa, 1);
+  pop_off();
+  HIST_END(HIST_KALLOC);
+  return pa;
+}
+
+// 分配一页可移动的页（已清零），用于用户数据页
+// 优先借用连续内存区的空闲页，把伙伴系统留给不可移动的分配；调用者映射后须记录反向映射，
+// 连续分配需要这一页时会通过 uvm_migrate 把它换成伙伴系统的页
+void *kalloc_movable(void) {
+  void *pa = cma_lend();
+  if (pa == 0)
+    pa = kalloc_movable_nozero();
+  if (pa)
+    page_zero(pa, 1);
+  return pa;
+}
+
+// 从伙伴系统的可迁移页块分配一页（内容未定义），不经过单页缓存
+// 单页缓存中的页会被不可迁移的分配复用，可迁移页直接在伙伴系统中分配和释放
+void *kalloc_movable_nozero(void) {
+  acquire(&kmem.lock);
+  void *pa = alloc_block(0, MIGRATE_MOVABLE);
+  if (pa)
+    page_flags[pa2idx((uint64)pa)] |= PG_MOVABLE;
+  else
+    kmem.stats[0].failures++;
+  release(&kmem.lock);
+  return pa;
+}
+
+// 适配接口：分配一页（内容未定义）
+// 内存耗尽时退而使用预清零页池中的页
+void *kalloc_nozero(void) {
+  push_off();
+  void *pa = mag_get(&mags[cpuid()], 1);
+  pop_off();
+  return pa;
+}
+
+// 后台补充本 hart 的预清零页池，最多清零 budget 页，返回实际补充的页数
+// 只有本 hart 会向自己的池中放页，因此检查与放入之间无需保持关中断
+int kzero_pool_refill(int budget) {
+  int n = 0;
+  while (n < budget) {
+    push_off();
+    struct magazine *m = &mags[cpuid()];
+    void *pa = m->nzeroed < ZERO_POOL_SIZE ? mag_get(m, 0) : 0;
+    pop_off();
+    if (pa == 0)
+      break;
+
+    page_zero(pa, 1); // 临界区外清零，RVV 实现也只关中断一页的时间
+
+    push_off();
+    page_flags[pa2idx((uint64)pa)] |= PG_CACHED;
+    m->zeroed[m->nzeroed++] = pa;
+    pop_off();
+    n++;
+  }
+  return n;
+}
+
+// 可移动页归还伙伴系统：锁外看到的 PG_MOVABLE 在 kmem.lock 内重新确认
+// 规整迁移走的旧页已清除 PG_MOVABLE 并随窗口交给了别的调用者，不能再放回空闲链表；
+// 持有者在 pt_lock 内清除反向映射之后才释放，规整因而不会迁移正在释放的页，这里只是兜底
+static void movable_free(void *pa) {
+  int idx = pa2idx((uint64)pa);
+  acquire(&kmem.lock);
+  if ((page_flags[idx] & PG_MOVABLE) && !(page_flags[idx] & PG_FREE)) {
+    page_private[idx] = 0;
+    free_block((uint64)pa);
+  }
+  release(&kmem.lock);
+}
+
+// 若页仍被共享则减少一个额外引用并返回1，否则返回0（调用者应真正释放）
+static int page_unref(int idx) {
+  for (;;) {
+    uint32 r = page_refs[idx];
+    if (r == 0)
+      return 0;
+    if (__sync_bool_compare_and_swap(&page_refs[idx], r, r - 1))
+      return 1;
+  }
 }
 
 // 适配接口：释放内存
+// 单页放入本 hart 的缓存，多页块直接归还伙伴系统
+static void free_page(void *pa) {
+  if (pa == 0 || !valid_pa((uint64)pa))
+    return;
+
+  // 写时复制共享的页，最后一个持有者释放时才归还
+  if (page_unref(pa2idx((uint64)pa)))
+    return;
+
+  // 从连续内存区借出的页还给它，可迁移页直接归还伙伴系统
+  if (cma_contains(pa)) {
+    page_private[pa2idx((uint64)pa)] = 0;
+    cma_return(pa);
+    return;
+  }
+  if (page_flags[pa2idx((uint64)pa)] & PG_MOVABLE) {
+    movable_free(pa);
+    return;
+  }
+
+  // 块已分配给调用者，page_orders 此时不会被并发修改
+  if (page_orders[pa2idx((uint64)pa)] != 0) {
+    buddy_free(pa);
+    return;
+  }
+
+  // 缓存中的页不在空闲链表上，伙伴系统查不出重复释放，由 PG_CACHED 发现；
+  // 已在空闲块内的页同样是重复释放。合法持有的页不会被并发地划入空闲块，不持锁检查即可
+  int idx = pa2idx((uint64)pa);
+  if ((page_flags[idx] & PG_CACHED) || in_free_block((uint64)pa))
+    return;
+
+  push_off();
+  struct magazine *m = &mags[cpuid()];
+  if (m->count >= mag_high)
+    mag_drain(m, mag_low);
+  page_flags[idx] |= PG_CACHED;
+  m->pages[m->count++] = pa;
+  pop_off();
+}
+
 void kfree(void *pa) {
-  if(pa == 0) return;
-  buddy_free(pa);
+  HIST_BEGIN();
+  free_page(pa);
+  HIST_END(HIST_KFREE);
+}
+
+// 将本 hart 缓存的单页（含预清零页）全部归还伙伴系统
+// 预清零页直接归还，不经过 pages[]：缓存可能已满到 MAG_CAPACITY
+void kalloc_drain(void) {
+  push_off();
+  struct magazine *m = &mags[cpuid()];
+  acquire(&kmem.lock);
+  while (m->nzeroed > 0)
+    mag_release(m->zeroed[--m->nzeroed]);
+  while (m->count > 0)
+    mag_release(m->pages[--m->count]);
+  release(&kmem.lock);
+  pop_off();
+}
+
+// 调整单页缓存的低/高水位，要求 0 < low < high <= MAG_CAPACITY
+int kalloc_set_watermarks(int low, int high) {
+  if (low <= 0 || low >= high || high > MAG_CAPACITY)
+    return -1;
+  mag_low = low;
+  mag_high = high;
+  return 0;
+}
+
+void kalloc_set_antifrag(int group, int compact) {
+  acquire(&kmem.lock);
+  grouping = group;
+  compaction = compact;
+  release(&kmem.lock);
+}
+
+void kalloc_stats(struct kalloc_stats *st) {
+  acquire(&kmem.lock);
+  memmove(st->order, kmem.stats, sizeof(kmem.stats));
+  st->total_pages = kmem.total_pages;
+  st->free_pages = kmem.free_pages;
+  st->peak_pages = kmem.peak_pages;
+  st->compact_runs = kmem.compact_runs;
+  st->compact_success = kmem.compact_success;
+  st->compact_migrated = kmem.compact_migrated;
+  for (int mt = 0; mt < MIGRATE_TYPES; mt++)
+    st->pageblocks[mt] = 0;
+  for (uint64 b = 0; b < nr_pages >> PAGEBLOCK_ORDER; b++)
+    st->pageblocks[pageblock_types[b]]++;
+  release(&kmem.lock);
+
+  st->cached_pages = 0;
+  for (int i = 0; i < NCPU; i++)
+    st->cached_pages += mags[i].count + mags[i].nzeroed;
+  // 缓存计数在锁外读取，并发补充缓存时可能超过锁内快照中已分配的页数，截断以免相减回绕
+  uint64 held = st->total_pages - st->free_pages;
+  if (st->cached_pages > held)
+    st->cached_pages = held;
+  st->used_pages = held - st->cached_pages;
+
+  // 从高阶往低阶累加 >= 该阶的空闲页数，每阶 O(1)
+  uint64 usable = 0;
+  for (int o = MAX_ORDER; o >= 0; o--) {
+    usable += st->order[o].free_blocks << o;
+    st->frag_index[o] = st->free_pages ? 1000 - usable * 1000 / st->free_pages : 1000;
+  }
+}
+
+void kalloc_stats_dump(void) {
+  struct kalloc_stats st;
+  kalloc_stats(&st);
+
+  printf("=== Page Allocator ===\n");
+  printf("pages: total=%lu free=%lu cached=%lu used=%lu peak=%lu\n",
+         st.total_pages, st.free_pages, st.cached_pages, st.used_pages, st.peak_pages);
+  printf("pageblocks: movable=%lu unmovable=%lu  compaction: runs=%lu success=%lu migrated=%lu\n",
+         st.pageblocks[MIGRATE_MOVABLE], st.pageblocks[MIGRATE_UNMOVABLE],
+         st.compact_runs, st.compact_success, st.compact_migrated);
+  printf("order   free  allocs   frees  splits  merges  fails  frag\n");
+  for (int o = 0; o <= MAX_ORDER; o++) {
+    struct kalloc_order_stats *os = &st.order[o];
+    printf("%5d %6lu %7lu %7lu %7lu %7lu %6lu  %d.%03d\n", o, os->free_blocks, os->allocs,
+           os->frees, os->splits, os->merges, os->failures,
+           st.frag_index[o] / 1000, st.frag_index[o] % 1000);
+  }
+}
+
+// 读取/设置页的私有字，pa 可以是已分配页内的任意地址
+uint64 kpage_private(void *pa) {
+  uint64 a = PGROUNDDOWN((uint64)pa);
+  if (!valid_pa(a))
+    return 0;
+  return page_private[pa2idx(a)];
+}
+
+void kpage_set_private(void *pa, uint64 val) {
+  uint64 a = PGROUNDDOWN((uint64)pa);
+  if (valid_pa(a))
+    page_private[pa2idx(a)] = val;
+}
+
+void kpage_ref(void *pa) {
+  if (valid_pa((uint64)pa))
+    __sync_fetch_and_add(&page_refs[pa2idx((uint64)pa)], 1);
+}
+
+int kpage_refcount(void *pa) {
+  if (!valid_pa((uint64)pa))
+    return 0;
+  return page_refs[pa2idx((uint64)pa)] + 1;
 }
 
 // 适配接口：分配多页
@@ -178,5 +887,8 @@ void *kalloc_pages(int n) {
     
     if (order > MAX_ORDER) return 0;
     
-    return buddy_alloc(order);
+    void *pa = buddy_alloc(order);
+    if (pa)
+        page_zero(pa, 1 << order);
+    return pa;
 }
\ No newline at end of file
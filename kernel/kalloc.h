@@ -4,21 +4,132 @@
 // 物理内存分配器头文件
 // 声明内核物理内存管理接口
 
+#include "types.h"
+
+#define KALLOC_MAX_ORDER 10  // 伙伴系统最大阶数，2^10 * 4KB = 4MB
+#define PAGEBLOCK_ORDER  9   // 按迁移类型分组的粒度，2^9 * 4KB = 2MB
+
+// 迁移类型：同类分配集中在同类页块中
+#define MIGRATE_MOVABLE   0  // 可迁移：映射到唯一用户 PTE 的数据页，规整时可以搬走
+#define MIGRATE_UNMOVABLE 1  // 不可迁移：页表、slab 等内核对象
+#define MIGRATE_TYPES     2
+
+// 规整的工作量上限：一次高阶分配失败后的规整在持有 kmem.lock、关中断的情况下进行
+#define COMPACT_MAX_TRIES       4    // 最多尝试的候选窗口数
+#define COMPACT_MAX_MIGRATE     256  // 一次规整最多迁移的页数
+#define COMPACT_FRAG_THRESHOLD  500  // 碎片指数（千分比）不超过该值时认为缺的是内存而不是连续性，不规整
+#define COMPACT_MAX_DEFER_SHIFT 6    // 连续失败后最多推迟 2^6 次规整
+
+// 每阶的计数，由伙伴系统在持有锁时 O(1) 维护
+struct kalloc_order_stats {
+  uint64 free_blocks;  // 当前空闲块数
+  uint64 allocs;       // 该阶分配成功次数
+  uint64 frees;        // 该阶块被释放的次数
+  uint64 splits;       // 该阶块被拆分的次数
+  uint64 merges;       // 在该阶与伙伴合并的次数
+  uint64 failures;     // 该阶分配失败次数
+};
+
+struct kalloc_stats {
+  struct kalloc_order_stats order[KALLOC_MAX_ORDER + 1];
+  uint64 total_pages;   // 伙伴系统管理的总页数
+  uint64 free_pages;    // 伙伴系统空闲链表中的页数
+  uint64 cached_pages;  // 各 hart 单页缓存与预清零池中的页数（对伙伴系统而言已分配）
+  uint64 used_pages;    // 调用者实际持有的页数：total - free - cached
+  uint64 peak_pages;    // 从伙伴系统分配出去的页数（含 hart 缓存）的历史最大值
+  // 碎片化指数（千分比）：空闲内存中无法满足该阶请求的比例，
+  // 0 表示空闲内存都在 >= 该阶的块中，1000 表示该阶请求必然失败
+  uint32 frag_index[KALLOC_MAX_ORDER + 1];
+  uint64 pageblocks[MIGRATE_TYPES];  // 各迁移类型的页块数
+  uint64 compact_runs;      // 高阶分配失败后尝试规整的次数
+  uint64 compact_success;   // 规整腾出块的次数
+  uint64 compact_migrated;  // 规整迁移的页数
+};
+
 /**
  * 初始化物理内存分配器
- * 将可用物理内存（从end到PHYSTOP）加入到空闲链表
+ * 按设备树给出的物理内存大小分配每页元数据，并将 end 到 PHYSTOP 之间
+ * 除保留区与元数据之外的内存加入空闲链表
+ * @note 必须在 fdt_init 之后调用
  */
 void kinit(void);
 
 /**
- * 分配一个物理页（4KB）
+ * 分配一个物理页（4KB），内容已清零
  * @return 成功返回页起始地址，失败返回0
+ * @note 优先从预清零页池取页，池空时在分配路径上清零
  */
 void* kalloc(void);
 
+/**
+ * 分配一个物理页（4KB），不保证内容清零
+ * @return 成功返回页起始地址，失败返回0
+ * @note 适用于调用者会立即完整覆盖页面内容的场景
+ */
+void* kalloc_nozero(void);
+
+/**
+ * 分配一个可移动的物理页，内容已清零
+ * @return 成功返回页起始地址，失败返回0
+ * @note 优先借用连续内存区的空闲页；只能用于映射到唯一用户 PTE 的数据页，
+ *       映射后须用 kpage_set_private 记录该 PTE 的地址，供迁移时改写
+ */
+void* kalloc_movable(void);
+
+/**
+ * 从伙伴系统的可迁移页块分配一个物理页，不保证内容清零
+ * @return 成功返回页起始地址，失败返回0
+ * @note 不借用连续内存区，用作迁移的目标页；使用约束与 kalloc_movable 相同
+ */
+void* kalloc_movable_nozero(void);
+
+/**
+ * 补充预清零页池，供空闲循环调用
+ * @param budget 本次最多清零的页数
+ * @return 实际补充的页数，池已满或内存不足时返回0
+ */
+int kzero_pool_refill(int budget);
+
+/**
+ * 将当前 hart 单页缓存中的页（含预清零页）全部归还伙伴系统
+ * @note 用于需要观察伙伴系统真实空闲状态的场景（统计、测试等）；
+ *       只归还调用者所在 hart 的缓存，其他 hart 的缓存须由它们各自调用
+ */
+void kalloc_drain(void);
+
+/**
+ * 调整每个 hart 单页缓存的水位
+ * @param low 缓存为空时一次补充到的页数，也是超过高水位后归还到的页数
+ * @param high 缓存页数达到该值时触发批量归还
+ * @return 成功返回0，参数非法返回-1
+ */
+int kalloc_set_watermarks(int low, int high);
+
+/**
+ * 开关反碎片机制，用于对比测试
+ * @param group 非0时按迁移类型分组分配
+ * @param compact 非0时高阶分配失败后尝试规整
+ * @note 关闭分组后新释放的块都进入可迁移链表，已有的页块类型保持不变
+ */
+void kalloc_set_antifrag(int group, int compact);
+
+/**
+ * 读取分配器统计的快照，O(MAX_ORDER + NCPU + 页块数)
+ * @note 各 hart 缓存的页数在不持锁的情况下读取，并发分配时只是近似值
+ */
+void kalloc_stats(struct kalloc_stats *st);
+
+/**
+ * 在控制台打印分配器统计
+ */
+void kalloc_stats_dump(void);
+
 /**
  * 释放一个物理页
  * @param pa 要释放的页的起始地址（必须页对齐）
+ * @note 单页先放入当前 hart 的缓存，超过高水位时批量归还伙伴系统；
+ *       可迁移页直接归还伙伴系统，借自连续内存区的页还给连续内存区；
+ *       已在缓存或空闲链表中的页再次释放时被忽略
  */
 void kfree(void *pa);
 
@@ -30,4 +141,48 @@ void kfree(void *pa);
  */
 void* kalloc_pages(int n);
 
+/**
+ * 伙伴系统底层接口：分配 2^order 个物理连续页（不可迁移），内容未定义
+ * @return 成功返回自然对齐的块起始地址，失败返回0
+ * @note 不经过单页缓存，调用 kfree 或 buddy_free 释放；
+ *       order > 0 且空闲链表中没有足够大的块时，迁移可迁移页规整出一个块。
+ *       规整持有 kmem.lock 并关中断：扫描一遍页元数据（每页一字节级的检查），
+ *       再迁移至多 COMPACT_MAX_MIGRATE 页，每页一次整页复制和两次全局 TLB 刷新（SBI 远程刷新），
+ *       最坏情况下本 hart 关中断的时间约为复制 1MB 内存加上数百次 SBI 调用；
+ *       碎片指数表明内存不足或该阶最近规整失败（按失败次数指数推迟）时直接放弃；
+ *       规整还持有 pt_lock，其间所有 hart 的缺页处理与用户页表修改都要等待，
+ *       因此调用者不得持有 pt_lock
+ */
+void* buddy_alloc(int order);
+
+/**
+ * 伙伴系统底层接口：释放 buddy_alloc 分配的块
+ */
+void buddy_free(void *pa);
+
+/**
+ * 读取已分配页的私有字（页内任意地址均可）
+ * @return 私有字，地址非法时返回0
+ * @note 私有字由页的使用者解释，释放页前使用者应将其清零
+ */
+uint64 kpage_private(void *pa);
+
+/**
+ * 设置已分配页的私有字
+ */
+void kpage_set_private(void *pa, uint64 val);
+
+/**
+ * 为已分配的块增加一个引用（写时复制共享）
+ * @param pa 块的起始地址
+ * @note 每次 kpage_ref 都需要一次对应的 kfree，最后一次 kfree 才真正释放
+ */
+void kpage_ref(void *pa);
+
+/**
+ * 查询已分配块的引用数
+ * @return 持有者个数（未共享时为1），地址非法时返回0
+ */
+int kpage_refcount(void *pa);
+
 #endif // KALLOC_H
\ No newline at end of file
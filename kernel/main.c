@@ -2,8 +2,24 @@
 #include "console.h"
 #include "uart.h"
 #include "sleep.h"
+#include "timer.h"
 #include "kalloc.h"
 #include "vm.h"
+#include "memlayout.h"
+#include "cpu.h"
+#include "sbi.h"
+#include "spinlock.h"
+#include "slab.h"
+#include "asid.h"
+#include "string.h"
+#include "trap.h"
+#include "plic.h"
+#include "hist.h"
+#include "pageops.h"
+#include "bench.h"
+#include "fdt.h"
+#include "cma.h"
+#include "param.h"
 #include <stdint.h>
 
 /* 测试辅助宏 */
@@ -15,6 +31,12 @@
 /* 内存测试配置 */
 #define TEST_PAGE_COUNT    16
 #define STRESS_TEST_COUNT  100
+#define PAGE_CACHE_MAX     256  // 单页缓存容量上限，与 kalloc.c 的 MAG_CAPACITY 一致
+
+/* time 计数差值转换为微秒 */
+static int ticks_to_us(uint64 ticks) {
+    return (int)(ticks * 1000000 / TIMEBASE_FREQ);
+}
 
 /* 断言测试工具 */
 static void assert(int condition, const char *msg) {
@@ -88,6 +110,242 @@ static void test_multiple_pages_alloc(void) {
     test_pass("Multiple pages allocation");
 }
 
+/* 预清零页池测试 */
+static void test_zero_pool(void) {
+    printf("\n=== Pre-zeroed Page Pool Test ===\n");
+
+    // 弄脏一页后释放，保证伙伴系统中存在非零页
+    char *dirty = (char *)kalloc_nozero();
+    assert(dirty != 0, "kalloc_nozero failed");
+    for (int i = 0; i < PGSIZE; i++)
+        dirty[i] = 0x5a;
+    kfree(dirty);
+
+    int filled = kzero_pool_refill(8);
+    printf("Refilled %d pre-zeroed pages\n", filled);
+
+    // 无论是否命中页池，kalloc 都必须返回全零页
+    for (int n = 0; n < 16; n++) {
+        char *page = (char *)kalloc();
+        assert(page != 0, "kalloc failed");
+        for (int i = 0; i < PGSIZE; i++)
+            assert(page[i] == 0, "kalloc returned non-zeroed page");
+        kfree(page);
+    }
+
+    test_pass("Pre-zeroed page pool");
+}
+
+/* 单页缓存水位测试 */
+static void test_page_cache(void) {
+    printf("\n=== Per-hart Page Cache Test ===\n");
+
+    void *pages[STRESS_TEST_COUNT];
+
+    assert(kalloc_set_watermarks(0, 8) < 0, "Invalid watermarks accepted");
+    assert(kalloc_set_watermarks(4, 8) == 0, "Setting watermarks failed");
+
+    // 反复越过高水位，检验批量补充/归还路径不会重复发放同一页
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < STRESS_TEST_COUNT; i++) {
+            pages[i] = kalloc();
+            assert(pages[i] != 0, "Allocation through page cache failed");
+            *(int *)pages[i] = i;
+        }
+        for (int i = 0; i < STRESS_TEST_COUNT; i++) {
+            assert(*(int *)pages[i] == i, "Page handed out twice");
+            kfree(pages[i]);
+        }
+    }
+
+    // 重复释放缓存中的单页被忽略，同一页不会连续发放两次
+    void *p = kalloc();
+    assert(p != 0, "Allocation through page cache failed");
+    kfree(p);
+    kfree(p);
+    void *a = kalloc(), *b = kalloc();
+    assert(a != 0 && b != 0 && a != b, "Double free put a page in the cache twice");
+    kfree(a);
+    kfree(b);
+
+    // 高水位取上限时缓存可以满到容量上限，归还预清零页时不能写过缓存末尾
+    static void *full[PAGE_CACHE_MAX];
+    assert(kalloc_set_watermarks(1, PAGE_CACHE_MAX) == 0, "Setting watermarks failed");
+    for (int i = 0; i < PAGE_CACHE_MAX; i++) {
+        full[i] = kalloc_nozero();
+        assert(full[i] != 0, "Allocation through page cache failed");
+    }
+    kzero_pool_refill(8);
+    for (int i = 0; i < PAGE_CACHE_MAX; i++)
+        kfree(full[i]);
+    kalloc_drain();
+
+    kalloc_set_watermarks(16, 64);
+    kalloc_drain();
+    test_pass("Per-hart page cache");
+}
+
+/* 分配器统计测试：计数随分配、拆分、合并同步变化 */
+static void test_kalloc_stats(void) {
+    printf("\n=== Allocator Stats Test ===\n");
+
+    struct kalloc_stats before, mid, after;
+    kalloc_drain();
+    kalloc_stats(&before);
+    assert(before.total_pages == before.free_pages + before.cached_pages + before.used_pages,
+           "Page accounting does not add up");
+
+    uint64 free_blocks = 0;
+    for (int o = 0; o <= KALLOC_MAX_ORDER; o++)
+        free_blocks += before.order[o].free_blocks << o;
+    assert(free_blocks == before.free_pages, "Per-order free counts disagree with free pages");
+
+    void *pa = buddy_alloc(3);
+    assert(pa != 0, "Order-3 allocation failed");
+    kalloc_stats(&mid);
+    assert(mid.order[3].allocs == before.order[3].allocs + 1, "Order-3 alloc not counted");
+    assert(mid.free_pages == before.free_pages - 8, "Free pages not reduced by 8");
+    assert(mid.peak_pages >= mid.total_pages - mid.free_pages, "Peak below current usage");
+    if (before.order[3].free_blocks == 0) {
+        uint64 splits = 0;
+        for (int o = 4; o <= KALLOC_MAX_ORDER; o++)
+            splits += mid.order[o].splits - before.order[o].splits;
+        assert(splits > 0, "Split not counted");
+    }
+
+    buddy_free(pa);
+    kalloc_stats(&after);
+    assert(after.order[3].frees == before.order[3].frees + 1, "Order-3 free not counted");
+    assert(after.free_pages == before.free_pages, "Free pages not restored");
+
+    // 阶越高，空闲内存中无法满足请求的比例只会更大
+    assert(after.frag_index[0] == 0, "Order-0 requests can never be fragmented");
+    for (int o = 1; o <= KALLOC_MAX_ORDER; o++)
+        assert(after.frag_index[o] >= after.frag_index[o - 1], "Fragmentation index not monotonic");
+
+    kalloc_stats_dump();
+    test_pass("Allocator stats");
+}
+
+/* 多 hart 并发测试：从核在空闲循环中执行 smp_test_fn */
+static int nharts_online = 1;
+static void (*volatile smp_test_fn)(void);
+static volatile int smp_test_gen;
+static volatile int smp_test_done;
+
+/* 在所有在线 hart 上（含本 hart）同时执行 fn，返回时均已完成 */
+static void run_on_all_harts(void (*fn)(void)) {
+    smp_test_done = 0;
+    smp_test_fn = fn;
+    __sync_synchronize();
+    smp_test_gen++;
+    // 从核在 wfi 中等待，用核间中断唤醒
+    uint64 mask = 0;
+    for (int i = 0; i < NCPU; i++) {
+        if (i != cpuid() && cpus[i].started)
+            mask |= 1UL << i;
+    }
+    if (mask)
+        sbi_send_ipi(mask, 0);
+    fn();
+    while (smp_test_done < nharts_online - 1)
+        ;
+}
+
+#define SMP_CHURN_PAGES  64
+#define SMP_CHURN_ROUNDS 32
+static volatile int smp_churn_errors;
+
+static void smp_churn(void) {
+    void *pages[SMP_CHURN_PAGES];
+    int id = cpuid();
+
+    for (int r = 0; r < SMP_CHURN_ROUNDS; r++) {
+        for (int i = 0; i < SMP_CHURN_PAGES; i++) {
+            pages[i] = kalloc();
+            if (pages[i] == 0) {
+                __sync_fetch_and_add(&smp_churn_errors, 1);
+                continue;
+            }
+            *(int *)pages[i] = id;
+        }
+        for (int i = 0; i < SMP_CHURN_PAGES; i++) {
+            if (pages[i] == 0)
+                continue;
+            if (*(int *)pages[i] != id)
+                __sync_fetch_and_add(&smp_churn_errors, 1);
+            kfree(pages[i]);
+        }
+    }
+}
+
+/* 多 hart 并发分配释放测试 */
+static void test_smp_page_churn(void) {
+    printf("\n=== SMP Page Churn Test (%d harts) ===\n", nharts_online);
+
+    smp_churn_errors = 0;
+    run_on_all_harts(smp_churn);
+    assert(smp_churn_errors == 0, "Concurrent kalloc/kfree corrupted pages");
+
+    test_pass("SMP page churn");
+}
+
+/* slab 分配器测试 */
+static int slab_ctor_calls;
+
+static void slab_test_ctor(void *obj) {
+    slab_ctor_calls++;
+    *(uint64 *)obj = 0xC0FFEE;
+}
+
+static void test_slab_alloc(void) {
+    printf("\n=== Slab Allocator Test ===\n");
+
+    // 1. 各个通用大小级别的分配、对齐与读写
+    void *objs[STRESS_TEST_COUNT];
+    for (int i = 0; i < STRESS_TEST_COUNT; i++) {
+        uint size = 1 + (i * 37) % 2048;
+        objs[i] = kmalloc(size);
+        assert(objs[i] != 0, "kmalloc failed");
+        assert(((uint64)objs[i] & 7) == 0, "kmalloc object not 8-byte aligned");
+        char *p = (char *)objs[i];
+        for (uint j = 0; j < size; j++)
+            p[j] = (char)i;
+    }
+    for (int i = 0; i < STRESS_TEST_COUNT; i++) {
+        assert(*(char *)objs[i] == (char)i, "kmalloc objects overlap");
+        kmfree(objs[i]);
+    }
+    printf("kmalloc/kmfree of %d objects (1B ~ 2KB) ok\n", STRESS_TEST_COUNT);
+
+    // 2. 超过 2KB 的请求直接按页分配
+    void *big = kmalloc(3 * PGSIZE);
+    assert(big != 0 && ((uint64)big % PGSIZE) == 0, "Large kmalloc not page-backed");
+    kmfree(big);
+
+    // 3. 具名缓存：按 NPROC 预留，构造函数只在建立 slab 时调用
+    struct kmem_cache *cache = kmem_cache_create("test_proc", 200, slab_test_ctor);
+    assert(cache != 0, "kmem_cache_create failed");
+    assert(kmem_cache_reserve(cache, NPROC) == 0, "kmem_cache_reserve failed");
+    int ctor_calls = slab_ctor_calls;
+    assert(ctor_calls >= NPROC, "Constructor not run for reserved objects");
+
+    void *procs[NPROC];
+    for (int i = 0; i < NPROC; i++) {
+        procs[i] = kmem_cache_alloc(cache);
+        assert(procs[i] != 0, "kmem_cache_alloc failed");
+        assert(*(uint64 *)procs[i] == 0xC0FFEE, "Object not constructed");
+    }
+    assert(slab_ctor_calls == ctor_calls, "Reserved slabs were rebuilt");
+    for (int i = 0; i < NPROC; i++)
+        kmem_cache_free(cache, procs[i]);
+    kmem_cache_shrink(cache);
+    printf("Named cache with %d reserved objects ok\n", NPROC);
+
+    slab_dump();
+    test_pass("Slab allocator");
+}
+
 /* 页表创建和销毁测试 */
 static void test_pagetable_creation(void) {
     printf("\n=== Page Table Creation Test ===\n");
@@ -120,6 +378,792 @@ static void test_pagetable_creation(void) {
     test_pass("Page table creation and basic operations");
 }
 
+/* 统计页表中的页表页数量与各级叶子数量，depth 为递归深度 */
+static void count_pagetable(pagetable_t pt, int depth, int *tables, int leaves[3]) {
+    (*tables)++;
+    for (int i = 0; i < 512; i++) {
+        pte_t pte = pt[i];
+        if (!(pte & PTE_V))
+            continue;
+        if (PTE_LEAF(pte))
+            leaves[depth]++;
+        else
+            count_pagetable((pagetable_t)PTE2PA(pte), depth + 1, tables, leaves);
+    }
+}
+
+/* 大页映射测试 */
+static void test_superpage_mapping(void) {
+    printf("\n=== Superpage Mapping Test ===\n");
+
+    // 1. 内核直接映射应主要由 2MB 大页组成
+    extern pagetable_t kernel_pagetable;
+    int tables = 0, leaves[3] = {0, 0, 0};
+    count_pagetable(kernel_pagetable, 0, &tables, leaves);
+    printf("Kernel page table: %d table pages, leaves 1G=%d 2M=%d 4K=%d\n",
+           tables, leaves[0], leaves[1], leaves[2]);
+    assert(leaves[1] > 0, "Kernel direct map uses no megapages");
+
+    // 2. 4MB 对齐的物理块映射到非 2MB 对齐的区间，边缘应退回 4KB
+    uint64 pa = (uint64)kalloc_pages(1024);
+    assert(pa != 0, "4MB block allocation failed");
+    pagetable_t pt = uvmcreate();
+    assert(pt != 0, "Page table creation failed");
+    uint64 va = 0x40000000 - PGSIZE;
+    assert(mappages_sz(pt, va, 2 * MEGAPGSIZE + 2 * PGSIZE, pa - PGSIZE, PTE_R | PTE_W, GIGAPGSIZE) == 0,
+           "Superpage mapping failed");
+
+    tables = 0;
+    leaves[0] = leaves[1] = leaves[2] = 0;
+    count_pagetable(pt, 0, &tables, leaves);
+    assert(leaves[1] == 2 && leaves[2] == 2, "Unexpected leaf layout");
+
+    pte_t *pte = walk(pt, va + PGSIZE + 0x1234, 0);
+    assert(pte != 0 && PTE_LEAF(*pte), "Megapage walk failed");
+    assert(PTE2PA(*pte) == pa, "Megapage physical address mismatch");
+
+    destroy_pagetable(pt);
+    kfree((void *)pa);
+    test_pass("Superpage mapping");
+}
+
+/* 按字实现的 mem* 测试：各种对齐与长度下与逐字节结果一致，并给出整页操作的耗时 */
+#define MEMOPS_ROUNDS 64
+static void test_mem_ops(void) {
+    printf("\n=== mem* Test ===\n");
+
+    unsigned char *a = (unsigned char *)kalloc();
+    unsigned char *b = (unsigned char *)kalloc();
+    assert(a != 0 && b != 0, "Page allocation failed");
+
+    for (int off = 0; off < 16; off++) {
+        for (int n = 0; n < 200; n += 7) {
+            for (int i = 0; i < 512; i++)
+                a[i] = i;
+            memset(a + off, 0xA5, n);
+            for (int i = 0; i < 512; i++) {
+                int inside = i >= off && i < off + n;
+                assert(a[i] == (inside ? 0xA5 : (unsigned char)i), "memset wrote wrong bytes");
+            }
+
+            // 向后、向前重叠搬移各一次，结果应与逐字节搬移一致
+            for (int i = 0; i < 512; i++)
+                a[i] = i * 7;
+            memmove(a + off + 3, a + off, n);
+            for (int i = 0; i < n; i++)
+                assert(a[off + 3 + i] == (unsigned char)((off + i) * 7), "memmove backward overlap");
+            memmove(a + off, a + off + 3, n);
+            for (int i = 0; i < n; i++)
+                assert(a[off + i] == (unsigned char)((off + i) * 7), "memmove forward overlap");
+
+            memcpy(b + (off ^ 5), a + off, n);
+            assert(memcmp(b + (off ^ 5), a + off, n) == 0, "memcpy/memcmp mismatch");
+            if (n > 0) {
+                b[(off ^ 5) + n - 1] ^= 0x80;
+                assert(memcmp(b + (off ^ 5), a + off, n) != 0, "memcmp missed difference");
+            }
+        }
+    }
+
+    uint64 t0 = r_cycle();
+    for (int i = 0; i < MEMOPS_ROUNDS; i++)
+        memset(a, 0, PGSIZE);
+    uint64 t1 = r_cycle();
+    for (int i = 0; i < MEMOPS_ROUNDS; i++)
+        memcpy(b, a, PGSIZE);
+    uint64 t2 = r_cycle();
+    printf("memset 4KB: %d cycles, memcpy 4KB: %d cycles\n",
+           (int)((t1 - t0) / MEMOPS_ROUNDS), (int)((t2 - t1) / MEMOPS_ROUNDS));
+
+    kfree(a);
+    kfree(b);
+    test_pass("Word-wide mem*");
+}
+
+/* 整页操作测试：RVV 与标量实现结果一致，并比较两者每页的耗时 */
+#define PAGEOPS_PAGES 4
+static void test_pageops(void) {
+    printf("\n=== Page Ops Test (%s) ===\n", pageops_vector ? "RVV" : "scalar");
+
+    unsigned char *a = (unsigned char *)kalloc_pages(PAGEOPS_PAGES);
+    unsigned char *b = (unsigned char *)kalloc_pages(PAGEOPS_PAGES);
+    assert(a != 0 && b != 0, "Page allocation failed");
+    uint64 bytes = PAGEOPS_PAGES * PGSIZE;
+
+    for (uint64 i = 0; i < bytes; i++)
+        a[i] = (unsigned char)(i * 13 + 1);
+    page_copy(b, a, PAGEOPS_PAGES);
+    assert(memcmp(a, b, bytes) == 0, "page_copy mismatch");
+    assert(page_cmp(a, b, PAGEOPS_PAGES) == 0, "page_cmp reported difference");
+
+    // 最后一页的末尾字节不同，page_cmp 应与 memcmp 同号
+    b[bytes - 1] = a[bytes - 1] + 1;
+    assert(page_cmp(a, b, PAGEOPS_PAGES) < 0, "page_cmp missed difference");
+    assert(page_cmp(b, a, PAGEOPS_PAGES) > 0, "page_cmp wrong sign");
+
+    page_zero(a, PAGEOPS_PAGES);
+    for (uint64 i = 0; i < bytes; i++)
+        assert(a[i] == 0, "page_zero left nonzero byte");
+
+    // 同一台机器上分别计时两种实现
+    int saved = pageops_vector;
+    for (int v = saved; v >= 0; v--) {
+        pageops_vector = v;
+        uint64 t0 = r_cycle();
+        page_zero(a, PAGEOPS_PAGES);
+        uint64 t1 = r_cycle();
+        page_copy(b, a, PAGEOPS_PAGES);
+        uint64 t2 = r_cycle();
+        page_cmp(a, b, PAGEOPS_PAGES);
+        uint64 t3 = r_cycle();
+        printf("%s: zero %d, copy %d, cmp %d cycles/page\n", v ? "RVV   " : "scalar",
+               (int)((t1 - t0) / PAGEOPS_PAGES), (int)((t2 - t1) / PAGEOPS_PAGES),
+               (int)((t3 - t2) / PAGEOPS_PAGES));
+    }
+    pageops_vector = saved;
+
+    kfree(a);
+    kfree(b);
+    test_pass("Page ops");
+}
+
+/* kvminit 微基准：比较大页、4KB 区间映射与逐页映射三种建表方式 */
+static void bench_kvminit(void) {
+    printf("\n=== kvminit Benchmark ===\n");
+
+    // 1. 当前 kvminit 的做法：区间映射 + 大页
+    uint64 t0 = r_time();
+    pagetable_t pt = kvmmake(GIGAPGSIZE);
+    uint64 t_huge = r_time() - t0;
+    destroy_pagetable(pt);
+
+    // 2. 只用 4KB 叶子的区间映射：每 2MB 才从根重新查找一次
+    t0 = r_time();
+    pt = kvmmake(PGSIZE);
+    uint64 t_range = r_time() - t0;
+    destroy_pagetable(pt);
+
+    // 3. 旧做法：对内核区间逐页调用 mappages，每页都从根查找
+    t0 = r_time();
+    pt = uvmcreate();
+    assert(pt != 0, "Page table creation failed");
+    for (uint64 a = KERNBASE; a < PHYSTOP; a += PGSIZE)
+        mappages(pt, a, PGSIZE, a, PTE_R | PTE_W);
+    uint64 t_page = r_time() - t0;
+    destroy_pagetable(pt);
+
+    printf("kvmmake (superpages, range walk): %d us\n", ticks_to_us(t_huge));
+    printf("kvmmake (4K leaves, range walk):  %d us\n", ticks_to_us(t_range));
+    printf("per-page mappages (4K, old way):  %d us\n", ticks_to_us(t_page));
+}
+
+/* 虚拟地址转换、权限修改与解除映射测试 */
+static void test_virtual_translation(void) {
+    printf("\n=== Virtual Address Translation Test ===\n");
+
+    pagetable_t pt = uvmcreate();
+    assert(pt != 0, "Page table creation failed");
+    // 先载入一次使页表获得 ASID，之后的修改才需要刷新 TLB
+    kvmshare(pt);
+    uvmswitch(pt);
+    kvmswitch();
+
+    // 1. uvmalloc 分配 16 页，walkaddr 应返回含页内偏移的物理地址
+    // 用户区间位于 USERBASE 之上，避开 kvmshare 共享的内核根表项
+    uint64 base = USERBASE;
+    uint64 sz = 16 * PGSIZE;
+    assert(uvmalloc(pt, base, base + sz, PTE_R | PTE_W | PTE_U) == base + sz, "uvmalloc failed");
+    for (uint64 a = base; a < base + sz; a += PGSIZE) {
+        uint64 pa = walkaddr(pt, a + 0x123);
+        assert(pa != 0 && (pa & (PGSIZE - 1)) == 0x123, "walkaddr offset mismatch");
+        assert(*(uint64 *)PGROUNDDOWN(pa) == 0, "uvmalloc page not zeroed");
+    }
+    assert(walkaddr(pt, base + sz) == 0, "walkaddr on unmapped page");
+    assert(walkaddr(pt, 1L << 40) == 0, "walkaddr beyond MAXVA");
+
+    // 2. 大页也能正确转换
+    uint64 mpa = (uint64)kalloc_pages(512);
+    assert(mpa != 0, "2MB block allocation failed");
+    uint64 mva = 0x40000000;
+    assert(mappages_sz(pt, mva, MEGAPGSIZE, mpa, PTE_R | PTE_W, MEGAPGSIZE) == 0, "Megapage mapping failed");
+    assert(walkaddr(pt, mva + 0x12345) == mpa + 0x12345, "Megapage walkaddr mismatch");
+
+    // 3. uvmprotect 修改权限；非法权限与部分覆盖大页应失败
+    assert(uvmprotect(pt, base, 4 * PGSIZE, PTE_R | PTE_U) == 0, "uvmprotect failed");
+    pte_t *pte = walk(pt, base, 0);
+    assert(pte && !(*pte & PTE_W) && (*pte & PTE_R), "uvmprotect did not clear PTE_W");
+    pte = walk(pt, base + 4 * PGSIZE, 0);
+    assert(pte && (*pte & PTE_W), "uvmprotect changed page outside range");
+    assert(uvmprotect(pt, base, PGSIZE, PTE_W) == -1, "W without R accepted");
+    assert(uvmprotect(pt, base, PGSIZE, 0) == -1, "Empty permission accepted");
+    assert(uvmprotect(pt, mva, PGSIZE, PTE_R) == -1, "Partial megapage protect accepted");
+    assert(uvmprotect(pt, mva, MEGAPGSIZE, PTE_R) == 0, "Megapage protect failed");
+
+    // 4. 批量解除映射：跨越空洞，TLB 按页刷新
+    struct tlb_stats before = tlb_stats;
+    uvmunmap(pt, base + 2 * PGSIZE, 4, 1);
+    for (int i = 2; i < 6; i++)
+        assert(walkaddr(pt, base + i * PGSIZE) == 0, "uvmunmap left mapping");
+    assert(walkaddr(pt, base + 6 * PGSIZE) != 0, "uvmunmap removed too much");
+    assert(tlb_stats.page_flushes - before.page_flushes == 4, "Expected 4 per-page flushes");
+
+    // 5. 大页只需对其中任一地址刷新一次；超过阈值的批次退化为一次整体刷新
+    before = tlb_stats;
+    uvmunmap(pt, mva, MEGAPGSIZE / PGSIZE, 0);
+    assert(walkaddr(pt, mva) == 0, "Megapage unmap failed");
+    assert(tlb_stats.page_flushes - before.page_flushes == 1, "Megapage unmap should flush once");
+    kfree((void *)mpa);
+
+    before = tlb_stats;
+    struct tlb_batch tb;
+    tlb_batch_init(&tb, pt);
+    for (int i = 0; i < TLB_FLUSH_THRESHOLD + 1; i++)
+        tlb_batch_add(&tb, base + i * PGSIZE);
+    tlb_batch_flush(&tb);
+    assert(tlb_stats.global_flushes - before.global_flushes == 1, "Expected one global flush");
+
+    // 解除映射的物理页暂存在批处理中，刷新 TLB 之后才释放
+    tlb_batch_init(&tb, pt);
+    uvmunmap_batch(pt, base + 6 * PGSIZE, 2, 1, &tb);
+    assert(tb.nfree == 2, "Unmapped pages freed before the TLB flush");
+    tlb_batch_flush(&tb);
+    assert(tb.nfree == 0, "Unmapped pages not freed after the TLB flush");
+
+    // 6. uvmdealloc 释放剩余页
+    assert(uvmdealloc(pt, base + sz, base) == base, "uvmdealloc failed");
+    for (uint64 a = base; a < base + sz; a += PGSIZE)
+        assert(walkaddr(pt, a) == 0, "uvmdealloc left mapping");
+
+    destroy_pagetable(pt);
+    printf("TLB flushes: page=%d global=%d remote=%d\n",
+           (int)tlb_stats.page_flushes, (int)tlb_stats.global_flushes, (int)tlb_stats.remote_flushes);
+    test_pass("Virtual address translation");
+}
+
+/* ASID 测试与地址空间切换基准：带 ASID 切换 vs 每次切换整体刷新 TLB */
+#define ASID_BENCH_ROUNDS 2000
+#define ASID_BENCH_PAGES  32
+
+static void touch_pages(uint64 va, int npages) {
+    for (int i = 0; i < npages; i++)
+        (*(volatile uint64 *)(va + i * PGSIZE))++;
+}
+
+static void bench_asid_switch(void) {
+    printf("\n=== ASID Switch Benchmark ===\n");
+    printf("ASID bits: %d\n", asid_bits);
+
+    uint64 va = USERBASE;
+    uint64 sz = ASID_BENCH_PAGES * PGSIZE;
+    pagetable_t as[2];
+    for (int i = 0; i < 2; i++) {
+        as[i] = uvmcreate();
+        assert(as[i] != 0, "Page table creation failed");
+        kvmshare(as[i]);
+        assert(uvmalloc(as[i], va, va + sz, PTE_R | PTE_W) == va + sz, "uvmalloc failed");
+    }
+
+    // 从未载入过的页表没有 ASID，修改它不需要刷新 TLB
+    struct tlb_stats before = tlb_stats;
+    assert(asid_of(as[0]) == ASID_NONE, "Fresh page table already has an ASID");
+    assert(uvmprotect(as[0], va, PGSIZE, PTE_R | PTE_W) == 0, "uvmprotect failed");
+    assert(tlb_stats.page_flushes == before.page_flushes, "Unloaded page table was flushed");
+
+    // 两个地址空间获得不同的 ASID，且写入的数据互不可见
+    uvmswitch(as[0]);
+    *(volatile uint64 *)va = 1;
+    uvmswitch(as[1]);
+    *(volatile uint64 *)va = 2;
+    uvmswitch(as[0]);
+    assert(*(volatile uint64 *)va == 1, "Address space 0 sees wrong data");
+    kvmswitch();
+    if (asid_bits > 0)
+        assert(asid_of(as[0]) != asid_of(as[1]) && asid_of(as[0]) != 0, "ASIDs not distinct");
+
+    // 1. 带 ASID 切换：只写 satp
+    uint64 t0 = r_time();
+    for (int r = 0; r < ASID_BENCH_ROUNDS; r++) {
+        uvmswitch(as[r & 1]);
+        touch_pages(va, ASID_BENCH_PAGES);
+    }
+    kvmswitch();
+    uint64 t_asid = r_time() - t0;
+
+    // 2. 旧做法：ASID 0 + 每次切换整体刷新
+    t0 = r_time();
+    for (int r = 0; r < ASID_BENCH_ROUNDS; r++) {
+        w_satp(MAKE_SATP(as[r & 1]));
+        sfence_vma();
+        touch_pages(va, ASID_BENCH_PAGES);
+    }
+    w_satp(MAKE_SATP(kernel_pagetable));
+    sfence_vma();
+    uint64 t_flush = r_time() - t0;
+
+    printf("%d switches, %d pages touched after each\n", ASID_BENCH_ROUNDS, ASID_BENCH_PAGES);
+    printf("tagged satp (ASID, no flush): %d us\n", ticks_to_us(t_asid));
+    printf("ASID 0 + sfence.vma:          %d us\n", ticks_to_us(t_flush));
+    printf("ASID rollovers: %d\n", (int)asid_rollovers);
+
+    for (int i = 0; i < 2; i++) {
+        uvmdealloc(as[i], va + sz, va);
+        destroy_pagetable(as[i]);
+    }
+    test_pass("ASID switch");
+}
+
+/* 写时复制测试：uvmcopy_cow 只复制页表，写入时才复制物理页 */
+#define COW_TEST_PAGES 256
+
+static void test_cow_copy(void) {
+    printf("\n=== Copy-on-Write Test ===\n");
+
+    uint64 va = USERBASE;
+    uint64 sz = COW_TEST_PAGES * PGSIZE;
+    pagetable_t parent = uvmcreate();
+    assert(parent != 0, "Page table creation failed");
+    kvmshare(parent);
+    assert(uvmalloc(parent, va, va + sz, PTE_R | PTE_W | PTE_U) == va + sz, "uvmalloc failed");
+    for (uint64 a = va; a < va + sz; a += PGSIZE)
+        *(uint64 *)walkaddr(parent, a) = a;
+
+    // 1. 复制后双方共享同一物理页，都变为只读 + PTE_COW
+    pagetable_t child = uvmcreate();
+    assert(child != 0, "Page table creation failed");
+    kvmshare(child);
+    uint64 t0 = r_time();
+    assert(uvmcopy_cow(parent, child) == 0, "uvmcopy_cow failed");
+    uint64 t_cow = r_time() - t0;
+    for (uint64 a = va; a < va + sz; a += PGSIZE) {
+        uint64 pa = walkaddr(parent, a);
+        assert(pa != 0 && pa == walkaddr(child, a), "COW pages not shared");
+        assert(kpage_refcount((void *)pa) == 2, "Shared page refcount should be 2");
+        pte_t *p = walk(parent, a, 0), *c = walk(child, a, 0);
+        assert(!(*p & PTE_W) && (*p & PTE_COW), "Parent PTE not marked COW");
+        assert(!(*c & PTE_W) && (*c & PTE_COW), "Child PTE not marked COW");
+    }
+
+    // 2. 子进程首次写入：得到私有副本，父进程内容不变
+    uint64 shared = walkaddr(parent, va);
+    assert(uvmcow_fault(child, va + 8) == 0, "COW fault failed");
+    uint64 copy = walkaddr(child, va);
+    assert(copy != shared, "COW fault did not copy");
+    assert(*(uint64 *)copy == va, "COW copy lost contents");
+    *(uint64 *)copy = 42;
+    assert(*(uint64 *)shared == va, "Write leaked into parent");
+    assert((*walk(child, va, 0) & PTE_W) && !(*walk(child, va, 0) & PTE_COW), "Child PTE not writable");
+    assert(kpage_refcount((void *)shared) == 1, "Refcount not dropped after copy");
+
+    // 3. 父进程成为唯一持有者，写入时直接恢复可写，不再复制
+    assert(uvmcow_fault(parent, va) == 0, "COW fault failed");
+    assert(walkaddr(parent, va) == shared, "Sole owner should not copy");
+    assert(uvmcow_fault(parent, va) == -1, "Non-COW page handled as COW");
+    assert(uvmcow_fault(parent, va + sz) == -1, "Unmapped page handled as COW");
+
+    // 4. 对比：逐页分配并复制的急切复制
+    pagetable_t eager = uvmcreate();
+    assert(eager != 0, "Page table creation failed");
+    t0 = r_time();
+    for (uint64 a = va; a < va + sz; a += PGSIZE) {
+        void *mem = kalloc_nozero();
+        assert(mem != 0, "Eager copy allocation failed");
+        memmove(mem, (void *)walkaddr(parent, a), PGSIZE);
+        assert(mappages(eager, a, PGSIZE, (uint64)mem, PTE_R | PTE_W | PTE_U) == 0, "Eager copy mapping failed");
+    }
+    uint64 t_eager = r_time() - t0;
+    printf("Copy %d pages: COW %d us, eager %d us\n",
+           COW_TEST_PAGES, ticks_to_us(t_cow), ticks_to_us(t_eager));
+
+    // 5. 释放：共享页在最后一个持有者释放时才归还
+    uint64 last = walkaddr(parent, va + PGSIZE);
+    uvmfree(child);
+    assert(kpage_refcount((void *)last) == 1, "Refcount not dropped by uvmfree");
+    uvmfree(parent);
+    uvmfree(eager);
+    test_pass("Copy-on-write");
+}
+
+/* 按需分配测试：保留大区间，只有被访问的页才分配物理页 */
+#define LAZY_TEST_SIZE  (64 * 1024 * 1024)
+#define LAZY_TEST_TOUCH 64
+#define LAZY_SMP_PAGES  256
+
+// 所有 hart 同时在同一批按需分配的页上缺页，每页只能被映射一次
+static pagetable_t lazy_smp_pt;
+
+static void lazy_smp_touch(void) {
+    uvmswitch(lazy_smp_pt);
+    for (int i = 0; i < LAZY_SMP_PAGES; i++)
+        __sync_fetch_and_add((uint64 *)(USERBASE + (uint64)i * PGSIZE), 1);
+    kvmswitch();
+}
+
+static void test_lazy_alloc(void) {
+    printf("\n=== Lazy Allocation Test ===\n");
+
+    uint64 va = USERBASE;
+    pagetable_t pt = uvmcreate();
+    assert(pt != 0, "Page table creation failed");
+    kvmshare(pt);
+    assert(uvmlazy(pt, va, LAZY_TEST_SIZE, PTE_R | PTE_W) == 0, "uvmlazy failed");
+    assert(walkaddr(pt, va) == 0, "Lazy region mapped up front");
+
+    // 1. 在 64MB 区间中稀疏地读写，每一页首次访问触发一次缺页
+    struct fault_stats before = fault_stats;
+    uint64 stride = LAZY_TEST_SIZE / LAZY_TEST_TOUCH;
+    uvmswitch(pt);
+    for (int i = 0; i < LAZY_TEST_TOUCH; i++) {
+        volatile uint64 *p = (volatile uint64 *)(va + i * stride + 8);
+        if (i % 2 == 0) {
+            assert(*p == 0, "Lazy page not zeroed");  // 读缺页
+        } else {
+            *p = i;                                    // 写缺页
+        }
+    }
+    // 已映射的页再次访问不会缺页
+    for (int i = 1; i < LAZY_TEST_TOUCH; i += 2)
+        assert(*(volatile uint64 *)(va + i * stride + 8) == (uint64)i, "Lazy page lost data");
+    kvmswitch();
+
+    assert(fault_stats.lazy - before.lazy == LAZY_TEST_TOUCH, "Unexpected lazy fault count");
+    int mapped = 0;
+    for (uint64 a = va; a < va + LAZY_TEST_SIZE; a += PGSIZE)
+        mapped += walkaddr(pt, a) != 0;
+    assert(mapped == LAZY_TEST_TOUCH, "Only touched pages should be mapped");
+    printf("Touched %d of %d pages\n", mapped, LAZY_TEST_SIZE / PGSIZE);
+
+    // 2. 写时复制页经由缺页处理复制
+    pagetable_t child = uvmcreate();
+    assert(child != 0, "Page table creation failed");
+    kvmshare(child);
+    assert(uvmcopy_cow(pt, child) == 0, "uvmcopy_cow failed");
+    uvmswitch(child);
+    *(volatile uint64 *)(va + stride + 8) = 100;
+    kvmswitch();
+    assert(fault_stats.cow - before.cow == 1, "Expected one COW fault");
+    assert(*(uint64 *)(walkaddr(pt, va + stride + 8)) == 1, "COW write leaked into parent");
+
+    // 3. 多个 hart 并发缺页：每页只映射一次，所有 hart 的写入都落在同一页上
+    lazy_smp_pt = uvmcreate();
+    assert(lazy_smp_pt != 0, "Page table creation failed");
+    kvmshare(lazy_smp_pt);
+    assert(uvmlazy(lazy_smp_pt, va, LAZY_SMP_PAGES * PGSIZE, PTE_R | PTE_W) == 0, "uvmlazy failed");
+    run_on_all_harts(lazy_smp_touch);
+    for (int i = 0; i < LAZY_SMP_PAGES; i++) {
+        uint64 pa = walkaddr(lazy_smp_pt, va + (uint64)i * PGSIZE);
+        assert(pa != 0 && *(uint64 *)pa == (uint64)nharts_online, "Concurrent lazy faults lost a write");
+    }
+
+    // 4. 多个 hart 并发写同一批写时复制页：每页只复制一次，共享页的引用只减一次
+    pagetable_t smp_parent = lazy_smp_pt;
+    lazy_smp_pt = uvmcreate();
+    assert(lazy_smp_pt != 0, "Page table creation failed");
+    kvmshare(lazy_smp_pt);
+    assert(uvmcopy_cow(smp_parent, lazy_smp_pt) == 0, "uvmcopy_cow failed");
+    run_on_all_harts(lazy_smp_touch);
+    for (int i = 0; i < LAZY_SMP_PAGES; i++) {
+        uint64 a = va + (uint64)i * PGSIZE;
+        uint64 ppa = walkaddr(smp_parent, a), cpa = walkaddr(lazy_smp_pt, a);
+        assert(ppa != cpa, "COW page not copied");
+        assert(*(uint64 *)cpa == 2 * (uint64)nharts_online, "Concurrent COW faults lost a write");
+        assert(*(uint64 *)ppa == (uint64)nharts_online, "COW write leaked into parent");
+        assert(kpage_refcount((void *)ppa) == 1, "Concurrent COW faults dropped extra references");
+    }
+    uvmfree(lazy_smp_pt);
+    uvmfree(smp_parent);
+
+    fault_stats_dump();
+    uvmfree(child);
+    uvmfree(pt);
+    test_pass("Lazy allocation");
+}
+
+/* 连续内存区测试：任意页数的连续分配，空闲页借给用户页，需要时迁移走 */
+#define CMA_TEST_PAGES 64
+
+static void test_cma(void) {
+    printf("\n=== Contiguous Region Test ===\n");
+
+    struct cma_stats st;
+    cma_stats(&st);
+    if (st.npages == 0) {
+        printf("CMA disabled, skipped\n");
+        return;
+    }
+
+    // 1. 非 2 的幂的页数，结果已清零且位于区域内
+    char *p = cma_alloc(3);
+    assert(p != 0, "cma_alloc(3) failed");
+    assert(cma_contains(p) && cma_contains(p + 3 * PGSIZE - 1), "CMA block outside region");
+    for (int i = 0; i < 3 * PGSIZE; i++)
+        assert(p[i] == 0, "CMA block not zeroed");
+    memset(p, 0xab, 3 * PGSIZE);
+    cma_free(p, 3);
+
+    // 2. 空闲的区域把页借给用户页
+    uint64 va = USERBASE;
+    uint64 sz = CMA_TEST_PAGES * PGSIZE;
+    pagetable_t pt = uvmcreate();
+    assert(pt != 0, "Page table creation failed");
+    kvmshare(pt);
+    assert(uvmalloc(pt, va, va + sz, PTE_R | PTE_W | PTE_U) == va + sz, "uvmalloc failed");
+    int lent = 0;
+    for (uint64 a = va; a < va + sz; a += PGSIZE) {
+        uint64 pa = walkaddr(pt, a);
+        lent += cma_contains((void *)pa);
+        assert(*(uint64 *)pa == 0, "Lent page not zeroed");
+        *(uint64 *)pa = a ^ 0x5a5a;
+    }
+    assert(lent == CMA_TEST_PAGES, "User pages not lent from CMA");
+
+    // 3. 整个区域的连续分配（超过伙伴系统的最大阶）迁移走借出的页
+    uint64 t0 = r_time();
+    char *all = cma_alloc(st.npages);
+    uint64 t_all = r_time() - t0;
+    assert(all != 0, "Whole-region cma_alloc failed");
+    for (uint64 a = va; a < va + sz; a += PGSIZE) {
+        uint64 pa = walkaddr(pt, a);
+        assert(pa != 0 && !cma_contains((void *)pa), "Lent page not migrated");
+        assert(*(uint64 *)pa == (a ^ 0x5a5a), "Migrated page lost data");
+    }
+    struct cma_stats after;
+    cma_stats(&after);
+    assert(after.migrated - st.migrated == CMA_TEST_PAGES, "Unexpected migration count");
+    assert(after.lent == 0 && after.used == st.npages, "CMA accounting mismatch");
+    assert(cma_alloc(1) == 0, "Full region should not allocate");
+    printf("Allocated %d contiguous pages, migrated %d in %d us\n",
+           st.npages, CMA_TEST_PAGES, ticks_to_us(t_all));
+
+    // 4. 释放后区域恢复空闲
+    cma_free(all, st.npages);
+    uvmfree(pt);
+    cma_stats(&after);
+    assert(after.used == 0 && after.lent == 0, "CMA not empty after free");
+    test_pass("Contiguous region");
+}
+
+/* 碎片化压力测试：用户页与页表、内核页交错占满内存后释放大部分用户页，
+ * 比较关闭反碎片、只分组、分组加规整三种情况下 order-9/10 分配的成功次数 */
+#define FRAG_PIN_EVERY 16  // 每分配这么多页就夹一个不可迁移的内核页
+
+// 连续分配 order 阶块直到失败，返回成功次数，之后全部释放
+static int count_high_order(int order) {
+    void *head = 0, *p;
+    int n = 0;
+    while ((p = buddy_alloc(order)) != 0) {
+        *(void **)p = head;
+        head = p;
+        n++;
+    }
+    while (head) {
+        p = *(void **)head;
+        buddy_free(head);
+        head = p;
+    }
+    return n;
+}
+
+static void frag_round(int group, int compact, int *n9, int *n10) {
+    kalloc_set_antifrag(group, compact);
+    kalloc_drain();
+
+    // 1. 占满内存：每 FRAG_PIN_EVERY 页中一页是内核页，其余是用户页（页表页随之穿插其中）
+    uint64 va = USERBASE, sz = va;
+    pagetable_t pt = uvmcreate();
+    assert(pt != 0, "Page table creation failed");
+    kvmshare(pt);
+    void *pins = 0;
+    for (int i = 0;; i++) {
+        if (i % FRAG_PIN_EVERY == 0) {
+            void *pin = kalloc_nozero();
+            if (pin == 0)
+                break;
+            *(void **)pin = pins;
+            pins = pin;
+            continue;
+        }
+        if (uvmalloc(pt, sz, sz + PGSIZE, PTE_R | PTE_W | PTE_U) == 0)
+            break;
+        *(uint64 *)walkaddr(pt, sz) = sz;
+        sz += PGSIZE;
+    }
+    uint64 npages = (sz - va) / PGSIZE;
+
+    // 2. 释放 3/4 的用户页，剩下的散布在整个内存中
+    for (uint64 i = 0; i < npages; i++) {
+        if (i % 4 != 0)
+            uvmunmap(pt, va + i * PGSIZE, 1, 1);
+    }
+    kalloc_drain();
+
+    struct kalloc_stats before, after;
+    kalloc_stats(&before);
+    *n9 = count_high_order(9);
+    *n10 = count_high_order(10);
+    kalloc_stats(&after);
+    printf("grouping=%d compaction=%d: %d user pages, order-9 %d, order-10 %d, migrated %d, unmovable pageblocks %d\n",
+           group, compact, (int)npages, *n9, *n10, (int)(after.compact_migrated - before.compact_migrated),
+           (int)after.pageblocks[MIGRATE_UNMOVABLE]);
+
+    // 3. 留下的用户页（可能已被规整搬走）内容不变
+    for (uint64 i = 0; i < npages; i += 4) {
+        uint64 pa = walkaddr(pt, va + i * PGSIZE);
+        assert(pa != 0 && *(uint64 *)pa == va + i * PGSIZE, "User page lost data");
+    }
+    uvmfree(pt);
+    while (pins) {
+        void *next = *(void **)pins;
+        kfree(pins);
+        pins = next;
+    }
+    kalloc_drain();
+}
+
+static void test_fragmentation(void) {
+    printf("\n=== Fragmentation Stress Test ===\n");
+
+    // 占满连续内存区，用户页只能来自伙伴系统
+    struct cma_stats cs;
+    cma_stats(&cs);
+    void *cma_block = cs.npages ? cma_alloc(cs.npages) : 0;
+
+    // kalloc_drain 只归还本 hart 的缓存，其他 hart 缓存的页须由它们各自归还
+    run_on_all_harts(kalloc_drain);
+    struct kalloc_stats st;
+    kalloc_stats(&st);
+    uint64 free_before = st.free_pages + st.cached_pages;
+
+    int n9[3], n10[3];
+    frag_round(0, 0, &n9[0], &n10[0]);
+    frag_round(1, 0, &n9[1], &n10[1]);
+    frag_round(1, 1, &n9[2], &n10[2]);
+    kalloc_set_antifrag(1, 1);
+
+    kalloc_stats(&st);
+    assert(st.free_pages + st.cached_pages == free_before, "Pages leaked by fragmentation test");
+    assert(n9[2] > n9[0], "Anti-fragmentation did not help order-9 allocations");
+    assert(n9[2] + n10[2] > 0, "Compaction produced no high-order blocks");
+    if (cma_block)
+        cma_free(cma_block, cs.npages);
+    test_pass("Fragmentation stress");
+}
+
+/* 睡眠精度测试：sleep 由定时器中断唤醒，耗时应与请求一致 */
+static void test_sleep(void) {
+    printf("\n=== Sleep Test ===\n");
+
+    static const int ms[] = { 1, 10, 50 };
+    for (int i = 0; i < 3; i++) {
+        uint64 t0 = r_time();
+        sleep(ms[i]);
+        int us = ticks_to_us(r_time() - t0);
+        printf("sleep(%d) took %d us\n", ms[i], us);
+        assert(us >= ms[i] * 1000, "sleep returned early");
+        assert(us < ms[i] * 1000 + 20000, "sleep overslept by more than 20 ms");
+    }
+    test_pass("Timer sleep");
+}
+
+/* 控制台测试：开着中断时输出由 UART 发送空中断送出，关着中断时同步发完 */
+static void test_console_tx_intr(void) {
+    printf("\n=== Console Transmit Interrupt Test ===\n");
+
+    // 一行远长于 UART FIFO，第一批写入 FIFO 后其余字符只能由中断送出
+    uint64 before = console_tx_intr_count();
+    printf("console: %s%s\n",
+           "0123456789abcdef0123456789abcdef0123456789abcdef",
+           "0123456789abcdef0123456789abcdef0123456789abcdef");
+    uint64 deadline = r_time() + TIMEBASE_FREQ / 10;
+    while (console_pending() && r_time() < deadline)
+        ;
+    assert(!console_pending(), "Console buffer not drained by interrupts");
+    assert(console_tx_intr_count() > before, "No UART transmit interrupt taken");
+
+    // 中断关闭且不会在本次输出后打开：须同步发完，不能滞留在缓冲区中
+    intr_off();
+    console_puts("console: synchronous output with interrupts off\n");
+    int pending = console_pending();
+    intr_on();
+    assert(!pending, "Output left in buffer with interrupts off");
+    test_pass("Console transmit interrupt");
+}
+
+/* 时间轮测试：跨级别的定时器按到期顺序触发、不早于到期时刻，取消的定时器不触发 */
+#define WHEEL_TEST_TIMERS 64
+#define WHEEL_BENCH_OPS   4096
+static uint64 wheel_fired_at[WHEEL_TEST_TIMERS];
+static int wheel_order[WHEEL_TEST_TIMERS];
+static int wheel_nfired;
+static int wheel_periodic_runs;
+
+static void wheel_fire(struct timer *t) {
+    int i = (int)(uint64)t->arg;
+    wheel_fired_at[i] = jiffies();
+    wheel_order[wheel_nfired++] = i;
+}
+
+static void wheel_periodic(struct timer *t) {
+    if (++wheel_periodic_runs < 10)
+        timer_add(t, t->expires + 10);
+}
+
+static void test_timer_wheel(void) {
+    printf("\n=== Timer Wheel Test ===\n");
+
+    // 到期时间覆盖第 0 级（<64）、第 1 级（<4096）与级联边界
+    static struct timer timers[WHEEL_TEST_TIMERS];
+    uint64 start = jiffies();
+    uint64 delay[WHEEL_TEST_TIMERS];
+    wheel_nfired = 0;
+    for (int i = 0; i < WHEEL_TEST_TIMERS; i++) {
+        delay[i] = 1 + (uint64)(i * 37) % 300;
+        timer_init(&timers[i], wheel_fire, (void *)(uint64)i);
+        timer_add(&timers[i], start + delay[i]);
+    }
+    // 取消奇数号定时器；重复取消返回0
+    for (int i = 1; i < WHEEL_TEST_TIMERS; i += 2)
+        assert(timer_cancel(&timers[i]) == 1, "Cancel of pending timer failed");
+    assert(timer_cancel(&timers[1]) == 0, "Double cancel reported pending");
+
+    static struct timer periodic;
+    wheel_periodic_runs = 0;
+    timer_init(&periodic, wheel_periodic, 0);
+    timer_add(&periodic, start + 10);
+
+    // 远期定时器放在高层，取消后不影响其他定时器
+    static struct timer far;
+    timer_init(&far, wheel_fire, 0);
+    timer_add(&far, start + 10 * 60 * HZ);
+
+    sleep(300 * 1000 / HZ + 20);
+
+    assert(timer_cancel(&far) == 1, "Far timer fired or was lost");
+    assert(wheel_nfired == WHEEL_TEST_TIMERS / 2, "Wrong number of timers fired");
+    assert(wheel_periodic_runs == 10, "Periodic timer did not rearm");
+    for (int k = 0; k < wheel_nfired; k++) {
+        int i = wheel_order[k];
+        assert(i % 2 == 0, "Cancelled timer fired");
+        assert(wheel_fired_at[i] >= start + delay[i], "Timer fired early");
+        if (k > 0)
+            assert(delay[wheel_order[k - 1]] <= delay[i], "Timers fired out of order");
+    }
+
+    // O(1) 添加与取消：远期定时器的开销与已挂入的定时器数量无关
+    static struct timer bench[WHEEL_BENCH_OPS];
+    for (int i = 0; i < WHEEL_BENCH_OPS; i++)
+        timer_init(&bench[i], wheel_fire, 0);
+    uint64 t0 = r_cycle();
+    for (int i = 0; i < WHEEL_BENCH_OPS; i++)
+        timer_add(&bench[i], start + 1000 + (uint64)i * 97);
+    uint64 t1 = r_cycle();
+    for (int i = 0; i < WHEEL_BENCH_OPS; i++)
+        timer_cancel(&bench[i]);
+    uint64 t2 = r_cycle();
+    printf("timer_add: %d cycles/op, timer_cancel: %d cycles/op\n",
+           (int)((t1 - t0) / WHEEL_BENCH_OPS), (int)((t2 - t1) / WHEEL_BENCH_OPS));
+    test_pass("Timer wheel");
+}
+
 /* 内存压力测试 */
 static void test_memory_stress(void) {
     printf("\n=== Memory Stress Test ===\n");
@@ -199,9 +1243,13 @@ static void show_memory_info(void) {
     printf("Kernel base: 0x%lx\n", KERNBASE);
     printf("Physical memory top: 0x%lx\n", PHYSTOP);
     printf("Page size: %d bytes\n", PGSIZE);
-    
-    // 注意：需要扩展kalloc来提供统计信息，这里输出基本状态
-    printf("Memory system: Basic functionality operational\n");
+
+    // 页分配器的容量与碎片化情况
+    kalloc_stats_dump();
+    cma_dump();
+
+    // 热点路径的延迟分布
+    hist_dump();
 }
 
 /* 内存管理主测试入口 */
@@ -212,11 +1260,28 @@ void memory_test_suite(void) {
     test_kalloc_init();
     test_single_page_alloc();
     test_multiple_pages_alloc();
+    test_zero_pool();
+    test_page_cache();
+    test_kalloc_stats();
+    test_smp_page_churn();
+    test_slab_alloc();
+    test_mem_ops();
+    test_pageops();
     
     
-    // 第二阶段：虚拟内存测试（移除了地址转换测试）
+    // 第二阶段：虚拟内存测试
     test_pagetable_creation();
-    printf(ANSI_COLOR_YELLOW "[SKIP] Virtual address translation test (walkaddr not implemented)" ANSI_COLOR_RESET "\n");
+    test_superpage_mapping();
+    bench_kvminit();
+    test_virtual_translation();
+    bench_asid_switch();
+    test_cow_copy();
+    test_lazy_alloc();
+    test_cma();
+    test_fragmentation();
+    test_console_tx_intr();
+    test_sleep();
+    test_timer_wheel();
     
     // 第三阶段：强度和边界测试
     test_memory_stress();
@@ -228,8 +1293,73 @@ void memory_test_suite(void) {
     printf("\n=== Memory Management Tests Completed ===\n");
 }
 
+extern char _secondary_start[];   // entry.S 中的从核入口
+extern volatile int smp_released; // entry.S 中旧固件下的从核放行标志
+extern volatile int boot_lottery; // entry.S 中进入内核的 hart 数（启动 hart 抽签计数）
+
+/* 启动其余 hart，返回已上线的 hart 总数 */
+static int start_secondary_harts(void) {
+    int self = cpuid();
+
+    // 通过 SBI HSM 逐个启动；不存在的 hart 返回错误，直接跳过
+    int expected = 1;
+    for (int i = 0; i < NCPU; i++) {
+        if (i == self)
+            continue;
+        if (sbi_hart_start(i, (uint64)_secondary_start, 0) == 0)
+            expected++;
+    }
+    // 不支持 HSM 的旧固件下，其余 hart 已在 entry.S 中等待放行，
+    // 抽签计数减去启动 hart 自己就是等待中的 hart 数
+    __sync_synchronize();
+    expected += boot_lottery - 1;
+    smp_released = 1;
+
+    // 只等待确实被启动的 hart，最多 100ms，让从核完成各自的初始化
+    uint64 deadline = r_time() + TIMEBASE_FREQ / 10;
+    int online;
+    do {
+        online = 0;
+        for (int i = 0; i < NCPU; i++)
+            online += cpus[i].started;
+    } while (online < expected && r_time() < deadline);
+    return online;
+}
+
+/* 从核主入口，由 entry.S 中的 _secondary_start 调用 */
+void mpmain(void) {
+    struct cpu *c = mycpu();
+    c->hartid = cpuid();
+    kvminithart();     // 每个 hart 各自激活内核页表
+    trapinithart();
+    pageops_inithart();
+    timerinithart();   // 从核的时间轮：不开中断，wfi 返回后自行推进
+    __sync_synchronize();
+    c->started = 1;
+
+    // 从核不开中断，只用 sie.SSIE 让核间中断唤醒 wfi
+    w_sie(r_sie() | SIE_SSIE);
+
+    int seen = 0;
+    while(1) {
+        // 从核空闲循环：执行启动 hart 下发的并发测试，没有任务时停机
+        // 先清除 SSIP 再检查任务：检查之后到达的核间中断会让 wfi 立即返回
+        w_sip(r_sip() & ~SIP_SSIP);
+        if (smp_test_gen != seen) {
+            seen = smp_test_gen;
+            smp_test_fn();
+            __sync_fetch_and_add(&smp_test_done, 1);
+        } else {
+            wfi();
+            timer_run();
+        }
+    }
+}
+
 /* 系统主入口 */
 void main(void) {
+    uint64 boot_start = r_time();
+
     // 硬件初始化
     uart_init();
     console_init();
@@ -238,21 +1368,48 @@ void main(void) {
     
     // 关键初始化顺序
     printf("1. Initializing physical memory allocator...\n");
+    uint64 t0 = r_time();
+    fdt_init(boot_fdt); // 从设备树确定物理内存大小
+    pageops_init();    // 探测 V 扩展，选择整页清零/复制的实现
     kinit();           // 初始化物理内存分配器
+    printf("   kinit took %d us\n", ticks_to_us(r_time() - t0));
+    slab_init();       // 初始化 slab 对象分配器
     
     printf("2. Initializing virtual memory system...\n");
     kvminit();         // 初始化内核页表
     kvminithart();     // 激活分页机制
+    asid_init();       // 探测 ASID 位数
+    trapinithart();    // 设置陷入向量
+    plicinit();        // 设备中断：控制台输出改由 UART 发送空中断驱动
+    plicinithart();
+    timerinithart();
+    intr_on();
+    printf("   boot to paging took %d us\n", ticks_to_us(r_time() - boot_start));
+
+    mycpu()->hartid = cpuid();
+    mycpu()->started = 1;
+    printf("   boot hart %d, starting secondary harts...\n", cpuid());
+    nharts_online = start_secondary_harts();
+    printf("   %d hart(s) online\n", nharts_online);
     
+#ifdef CONFIG_BENCH
+    printf("3. Starting micro-benchmarks...\n");
+    bench_suite();
+#else
     printf("3. Starting memory management tests...\n");
     
     // 执行内存管理测试
     memory_test_suite();
+#endif
+    printf("\n");
+    lockstat_dump();
     printf("\n=== System Ready ===\n");
     
     // 主循环
     while(1) {
-        // 系统空闲循环
+        // 系统空闲循环：后台补充预清零页池，池满后停机等待中断
         // 可添加更多测试或shell接口
+        if (kzero_pool_refill(1) == 0)
+            wfi();
     }
 }
\ No newline at end of file
@@ -5,8 +5,14 @@
 #include "riscv.h" 
 
 // --- 1. 物理内存布局 ---
+#define RAMBASE  0x80000000L   // 物理内存起始，页元数据以此为第0页
 #define KERNBASE 0x80200000L   // 内核起始物理地址
-#define PHYSTOP  0x88000000L   // 物理内存结束 (128MB)
+
+// 物理内存结束地址，启动时由设备树的 memory 节点确定（fdt.c）
+extern uint64 phystop;
+#define PHYSTOP phystop
+#define PHYSTOP_DEFAULT 0x88000000L   // 没有设备树时假定 128MB
+#define PHYSTOP_MAX     0x2000000000L // 直接映射的上限，其上留给用户地址空间
 
 // --- 2. 设备地址 ---
 #define UART0    0x10000000L
@@ -14,12 +20,25 @@
 #define PLIC     0x0c000000L
 #define CLINT    0x2000000L
 
+// 中断号
+#define UART0_IRQ 10
+
+// PLIC 寄存器（S 模式上下文编号为 2*hart+1）
+#define PLIC_PRIORITY        (PLIC + 0x0)
+#define PLIC_SENABLE(hart)   (PLIC + 0x2080 + (hart) * 0x100)
+#define PLIC_SPRIORITY(hart) (PLIC + 0x201000 + (hart) * 0x2000)
+#define PLIC_SCLAIM(hart)    (PLIC + 0x201004 + (hart) * 0x2000)
+
+// QEMU virt 平台 time CSR 的计数频率 (10MHz)
+#define TIMEBASE_FREQ 10000000L
+
 // --- 3. 内核栈布局 ---
 #define KERNEL_STACK_PAGES 4
 #define KERNEL_STACK_SIZE (KERNEL_STACK_PAGES * PGSIZE)
 // 注意：KERNEL_STACK_TOP 通常是虚拟地址空间中的位置，这里仅作定义
 
 // --- 4. 用户空间布局 ---
+#define USERBASE PHYSTOP_MAX  // 用户映射的起始地址，位于内核直接映射之上
 #define TRAMPOLINE (MAXVA - PGSIZE)
 #define TRAPFRAME  (TRAMPOLINE - PGSIZE)
 #define USER_STACK_TOP TRAPFRAME
@@ -0,0 +1,79 @@
+// 整页操作的分发
+// sstatus.VS 是 WARL 字段：未实现 V 扩展的 hart 上写入后读回恒为0，
+// 因此写入 Initial 再读回即可探测，无需解析设备树或陷入非法指令。
+#include "types.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "string.h"
+#include "printf.h"
+#include "pageops.h"
+
+// pageops_rvv.S 中的向量实现，长度为字节数
+void rvv_zero(void *dst, uint64 n);
+void rvv_copy(void *dst, const void *src, uint64 n);
+int rvv_cmp(const void *a, const void *b, uint64 n);
+
+int pageops_vector;
+
+// 开启当前 hart 的向量状态，返回 V 扩展是否可用
+static int vector_enable(void) {
+  w_sstatus((r_sstatus() & ~SSTATUS_VS_MASK) | SSTATUS_VS_INITIAL);
+  return (r_sstatus() & SSTATUS_VS_MASK) != 0;
+}
+
+void pageops_init(void) {
+  pageops_vector = vector_enable();
+  printf("pageops: %s\n", pageops_vector ? "RVV" : "scalar");
+}
+
+void pageops_inithart(void) {
+  if (pageops_vector && !vector_enable())
+    panic("pageops_inithart: hart lacks V extension");
+}
+
+// 陷入时不保存向量寄存器，向量实现运行期间关中断，避免中断处理程序中的页操作破坏它们；
+// 逐页开关中断，多页操作的中断延迟也只有一页的时间
+void page_zero(void *pa, int npages) {
+  for (int i = 0; i < npages; i++) {
+    char *p = (char *)pa + i * PGSIZE;
+    if (pageops_vector) {
+      push_off();
+      rvv_zero(p, PGSIZE);
+      pop_off();
+    } else {
+      memset(p, 0, PGSIZE);
+    }
+  }
+}
+
+void page_copy(void *dst, const void *src, int npages) {
+  for (int i = 0; i < npages; i++) {
+    char *d = (char *)dst + i * PGSIZE;
+    const char *s = (const char *)src + i * PGSIZE;
+    if (pageops_vector) {
+      push_off();
+      rvv_copy(d, s, PGSIZE);
+      pop_off();
+    } else {
+      memcpy(d, s, PGSIZE);
+    }
+  }
+}
+
+int page_cmp(const void *a, const void *b, int npages) {
+  for (int i = 0; i < npages; i++) {
+    const char *x = (const char *)a + i * PGSIZE;
+    const char *y = (const char *)b + i * PGSIZE;
+    int r;
+    if (pageops_vector) {
+      push_off();
+      r = rvv_cmp(x, y, PGSIZE);
+      pop_off();
+    } else {
+      r = memcmp(x, y, PGSIZE);
+    }
+    if (r)
+      return r;
+  }
+  return 0;
+}
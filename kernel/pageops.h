@@ -0,0 +1,37 @@
+#ifndef PAGEOPS_H
+#define PAGEOPS_H
+
+// 整页清零 / 复制 / 比较
+// 启动时探测 V 扩展：可用时使用 RVV 实现（pageops_rvv.S），否则退回按字实现的 mem* 函数
+
+#include "types.h"
+
+extern int pageops_vector; // 1 表示使用 RVV 实现
+
+/**
+ * 探测 V 扩展并在启动 hart 上开启向量状态，应在第一次分配页之前调用
+ */
+void pageops_init(void);
+
+/**
+ * 在从核上开启向量状态，每个从核调用一次
+ */
+void pageops_inithart(void);
+
+/**
+ * 清零 npages 个连续页
+ */
+void page_zero(void *pa, int npages);
+
+/**
+ * 复制 npages 个连续页，区间不能重叠
+ */
+void page_copy(void *dst, const void *src, int npages);
+
+/**
+ * 比较 npages 个连续页
+ * @return 相同返回0，否则返回第一个不同字节之差（按无符号比较）
+ */
+int page_cmp(const void *a, const void *b, int npages);
+
+#endif // PAGEOPS_H
@@ -3,6 +3,7 @@
 
 #define NPROC        64    // 最大进程数量
 #define KSTACKSIZE   4096  // 每个进程的内核栈大小（字节）
+#define HARTSTACKSIZE 16384 // 每个 hart 的启动栈大小（字节）
 #define NCPU         8     // 最大CPU核心数
 #define NOFILE       16    // 每个进程可打开的最大文件数
 #define NFILE        100   // 系统全局最大打开文件数
@@ -12,8 +13,9 @@
 #define ROOTDEV      1     // 根文件系统设备号
 #define MAXARG       32    // 执行程序的最大参数数量
 #define LOGSIZE      10    // 磁盘日志的最大数据扇区数
-#define HZ           10    // 定时器频率（可选）
+#define HZ           1000  // 时间轮精度：每秒 jiffy 数
 #define N_CALLSTK    15    // 调用栈深度（特定实现）
+#define CMA_MB       16    // 连续内存区默认大小（MB），可用启动参数 cma= 覆盖
 
 #endif
 
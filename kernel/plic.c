@@ -0,0 +1,27 @@
+// PLIC（平台级中断控制器）
+// QEMU virt 平台上 UART0 的中断号为 UART0_IRQ
+#include "types.h"
+#include "riscv.h"
+#include "memlayout.h"
+#include "cpu.h"
+#include "plic.h"
+
+void plicinit(void) {
+  // 优先级为0的中断源永远不会被送达
+  *(volatile uint32 *)(PLIC_PRIORITY + UART0_IRQ * 4) = 1;
+}
+
+void plicinithart(void) {
+  int hart = cpuid();
+  *(volatile uint32 *)PLIC_SENABLE(hart) = 1u << UART0_IRQ;
+  *(volatile uint32 *)PLIC_SPRIORITY(hart) = 0;  // 阈值为0：接收所有优先级大于0的中断
+  w_sie(r_sie() | SIE_SEIE);
+}
+
+int plic_claim(void) {
+  return *(volatile uint32 *)PLIC_SCLAIM(cpuid());
+}
+
+void plic_complete(int irq) {
+  *(volatile uint32 *)PLIC_SCLAIM(cpuid()) = irq;
+}
@@ -0,0 +1,28 @@
+#ifndef PLIC_H
+#define PLIC_H
+
+// PLIC（平台级中断控制器）头文件
+
+/**
+ * 设置各设备中断源的优先级，启动 hart 调用一次
+ */
+void plicinit(void);
+
+/**
+ * 为当前 hart 的 S 模式上下文开启设备中断并打开 sie.SEIE
+ * @note 目前只有启动 hart 接收设备中断
+ */
+void plicinithart(void);
+
+/**
+ * 领取当前 hart 待处理的中断
+ * @return 中断号，没有待处理中断时返回0
+ */
+int plic_claim(void);
+
+/**
+ * 通知 PLIC 中断 irq 已处理完毕
+ */
+void plic_complete(int irq);
+
+#endif // PLIC_H
@@ -1,88 +1,58 @@
 #include "printf.h"
 #include "console.h"
 #include "string.h"
+#include "riscv.h"
+#include "param.h"
+#include "cpu.h"
+#include "spinlock.h"
+#include "hist.h"
 #include <stdarg.h>
 #include <stdint.h>
 
 // 数字字符查找表
 static const char digits[] = "0123456789abcdef";
 
-// 打印数字到控制台（带符号处理）
-static void print_num(int64_t num, int base, int sign, int width, int zero_pad) {
-    char buf[20]; // 足够存放64位二进制数
+// 格式化输出目标：每产生一个字符调用一次 putc
+struct outbuf {
+    void (*putc)(struct outbuf *ob, char c);
+    char *buf;   // sprintf 的目标缓冲区
+};
+
+// 格式化数字（带符号处理、宽度与零填充）
+static void format_num(struct outbuf *ob, uint64_t num, int base, int sign, int width, int zero_pad) {
+    char tmp[24]; // 足够存放64位十进制数
     int i = 0;
 
-    // 处理负数
-    if (sign && num < 0) {
-        console_putc('-');
+    // 处理负数，INT64_MIN 取反后按无符号数仍然正确
+    int neg = sign && (int64_t)num < 0;
+    if (neg) {
         num = -num;
-    }
-
-    // 特殊处理INT64_MIN
-    if (num == INT64_MIN) {
-        buf[i++] = '8'; // -2^63的最后一位
-        num = INT64_MAX / base;
-    }
-
-    // 数字转换
-    do {
-        buf[i++] = digits[num % base];
-    } while ((num /= base) > 0);
-
-     // 零填充或空格填充
-    while (i < width) {
-        console_putc(zero_pad ? '0' : ' ');
         width--;
     }
 
-    // 逆序输出
-    while (--i >= 0) {
-        console_putc(buf[i]);
-    }
-}
-
-static void printptr(uint64_t x) {
-    console_putc('0');
-    console_putc('x');
-    // 调用你现有的 print_num，基数16，无符号，无宽度限制
-    print_num(x, 16, 0, 0, 0);
-}
-
-// 将数字写入缓冲区（返回写入字符数）
-static int write_num(char *buf, int64_t num, int base, int sign) {
-    char tmp[20];
-    int i = 0, start = 0;
-
-    if (sign && num < 0) {
-        *buf++ = '-';
-        start++;
-        num = -num;
-    }
-
     do {
         tmp[i++] = digits[num % base];
     } while ((num /= base) > 0);
 
-    while (--i >= 0) {
-        *buf++ = tmp[i];
-        start++;
-    }
-    return start;
-}
+    // 零填充时负号在填充之前，空格填充时负号紧挨数字
+    if (neg && zero_pad)
+        ob->putc(ob, '-');
+    for (; width > i; width--)
+        ob->putc(ob, zero_pad ? '0' : ' ');
+    if (neg && !zero_pad)
+        ob->putc(ob, '-');
 
-// 安全字符串打印
-static void print_str(const char *s) {
-    if (!s) s = "(null)";
-    while (*s) console_putc(*s++);
+    // 逆序输出
+    while (--i >= 0)
+        ob->putc(ob, tmp[i]);
 }
 
-int printf(const char *fmt, ...) {
-    va_list ap;
-    va_start(ap, fmt);
-
+// printf 与 sprintf 共用的格式化逻辑
+// 支持 %d %u %x %p %s %c %%，数字可带 0 填充与宽度，%ld / %lu / %lx 读取 64 位参数
+static void vformat(struct outbuf *ob, const char *fmt, va_list ap) {
     while (*fmt) {
         if (*fmt != '%') {
-            console_putc(*fmt++);
+            ob->putc(ob, *fmt++);
             continue;
         }
 
@@ -90,6 +60,7 @@ int printf(const char *fmt, ...) {
 
         int width = 0;
         int zero_pad = 0;
+        int is_long = 0;
 
         // 处理填充和宽度
         if (*fmt == '0') {
@@ -99,74 +70,111 @@ int printf(const char *fmt, ...) {
         while (*fmt >= '0' && *fmt <= '9') {
             width = width * 10 + (*fmt++ - '0');
         }
+        while (*fmt == 'l') {
+            is_long = 1;
+            fmt++;
+        }
+        if (*fmt == '\0')
+            break;
 
         switch (*fmt++) {
-            case 'd': 
-                print_num(va_arg(ap, int), 10, 1, width, zero_pad); 
+            case 'd':
+                format_num(ob, is_long ? va_arg(ap, int64_t) : va_arg(ap, int), 10, 1, width, zero_pad);
                 break;
             case 'u':
-                print_num(va_arg(ap, unsigned), 10, 0, width, zero_pad);
+                format_num(ob, is_long ? va_arg(ap, uint64_t) : va_arg(ap, unsigned), 10, 0, width, zero_pad);
+                break;
+            case 'x':
+                format_num(ob, is_long ? va_arg(ap, uint64_t) : va_arg(ap, unsigned), 16, 0, width, zero_pad);
+                break;
+            case 'p':
+                ob->putc(ob, '0');
+                ob->putc(ob, 'x');
+                format_num(ob, va_arg(ap, uint64_t), 16, 0, width, zero_pad);
                 break;
-            case 'x': print_num(va_arg(ap, unsigned), 16, 0, width, zero_pad); break;
-            case 's': print_str(va_arg(ap, char*)); break;
-            case 'c': console_putc(va_arg(ap, int)); break;
-            case 'p': printptr(va_arg(ap, uint64_t)); break; // 这里现在能找到定义了
-            case '%': console_putc('%'); break;
+            case 's': {
+                const char *s = va_arg(ap, char*);
+                if (!s) s = "(null)";
+                while (*s) ob->putc(ob, *s++);
+                break;
+            }
+            case 'c': ob->putc(ob, va_arg(ap, int)); break;
+            case '%': ob->putc(ob, '%'); break;
             default:  // 回显无效格式
-                console_putc('%');
-                console_putc(fmt[-1]);
+                ob->putc(ob, '%');
+                ob->putc(ob, fmt[-1]);
         }
     }
+}
 
-    va_end(ap);
-    return 0;
+// 每个 hart 的行缓冲：printf 先格式化到这里，遇到换行或缓冲区满时整块交给控制台，
+// 一行只进入一次控制台临界区，多 hart 同时输出时行与行之间不会交错
+#define PRINTBUF_SIZE 128
+
+static struct {
+    char buf[PRINTBUF_SIZE];
+    int len;
+} printbufs[NCPU];
+
+// 把当前 hart 行缓冲中的内容交给控制台，调用者须关中断
+static void printbuf_flush(void) {
+    int id = cpuid();
+    if (printbufs[id].len > 0) {
+        console_write(printbufs[id].buf, printbufs[id].len);
+        printbufs[id].len = 0;
+    }
 }
 
-int sprintf(char *buf, const char *fmt, ...) {
+static void printbuf_putc(struct outbuf *ob, char c) {
+    (void)ob;
+    int id = cpuid();
+    printbufs[id].buf[printbufs[id].len++] = c;
+    if (c == '\n' || printbufs[id].len == PRINTBUF_SIZE)
+        printbuf_flush();
+}
+
+int printf(const char *fmt, ...) {
     va_list ap;
-    char *start = buf;
+    struct outbuf ob = { printbuf_putc, 0 };
+    HIST_BEGIN();
+
+    // 关中断期间当前 hart 的行缓冲不会被中断处理程序中的输出打乱
+    push_off();
     va_start(ap, fmt);
+    vformat(&ob, fmt, ap);
+    va_end(ap);
+    pop_off();
+    HIST_END(HIST_PRINTF);
+    return 0;
+}
 
-    while (*fmt) {
-        if (*fmt != '%') {
-            *buf++ = *fmt++;
-            continue;
-        }
+// 立即输出当前 hart 行缓冲中尚未换行的内容
+void printf_flush(void) {
+    push_off();
+    printbuf_flush();
+    pop_off();
+}
 
-        fmt++; // 跳过%
-        switch (*fmt++) {
-            case 'd': buf += write_num(buf, va_arg(ap, int), 10, 1); break;
-            case 'u': buf += write_num(buf, va_arg(ap, unsigned), 10, 0); break;
-            case 'x': buf += write_num(buf, va_arg(ap, unsigned), 16, 0); break;
-            case 's': {
-                char *s = va_arg(ap, char*);
-                if (!s) s = "(null)";
-                buf += strlen(strcpy(buf, s));
-                break;
-            }
-            case 'c': *buf++ = va_arg(ap, int); break;
-            
-            // [新增] 只有这里改动了一点点，增加了 %p 支持
-            case 'p': {
-                *buf++ = '0';
-                *buf++ = 'x';
-                buf += write_num(buf, va_arg(ap, uint64_t), 16, 0);
-                break;
-            }
+static void strbuf_putc(struct outbuf *ob, char c) {
+    *ob->buf++ = c;
+}
 
-            case '%': *buf++ = '%'; break;
-            default:  // 回显无效格式
-                *buf++ = '%';
-                *buf++ = fmt[-1];
-        }
-    }
+int sprintf(char *buf, const char *fmt, ...) {
+    va_list ap;
+    struct outbuf ob = { strbuf_putc, buf };
 
-    *buf = '\0';
+    va_start(ap, fmt);
+    vformat(&ob, fmt, ap);
     va_end(ap);
-    return buf - start;
+
+    *ob.buf = '\0';
+    return ob.buf - buf;
 }
 
 void panic(const char *s) {
+    intr_off();
+    console_panic();  // 之后的输出不再经过缓冲区和中断
+    printbuf_flush(); // 先输出本 hart 尚未换行的内容
     printf("PANIC: %s\n", s ? s : "Unknown error");
     for(;;); // 系统挂起
 }
\ No newline at end of file
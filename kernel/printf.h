@@ -5,6 +5,7 @@
 
 int printf(const char *fmt, ...);
 int sprintf(char *buf, const char *fmt, ...);
+void printf_flush(void);
 void panic(const char *s);
 
 #endif
\ No newline at end of file
@@ -19,6 +19,7 @@
 #define PTE_G (1L << 5)
 #define PTE_A (1L << 6)
 #define PTE_D (1L << 7)
+#define PTE_COW (1L << 8) // RSW 位：写时复制共享页，写入时由缺页处理复制
 
 // --- 3. 地址转换宏 ---
 #define PA2PTE(pa) ((((uint64)pa) >> 12) << 10)
@@ -29,11 +30,120 @@
 #define PXSHIFT(level)  (PGSHIFT+(9*(level)))
 #define PX(level, va) ((((uint64)(va)) >> PXSHIFT(level)) & 0x1FF)
 
+// 第 level 级叶子 PTE 映射的大小：0 级 4KB，1 级 2MB (megapage)，2 级 1GB (gigapage)
+#define PXSIZE(level)   (1L << PXSHIFT(level))
+#define MEGAPGSIZE      PXSIZE(1)
+#define GIGAPGSIZE      PXSIZE(2)
+
+// 有效 PTE 中 R/W/X 任一置位即为叶子，否则指向下一级页表
+#define PTE_LEAF(pte)   ((pte) & (PTE_R|PTE_W|PTE_X))
+
 // Sv39 最大虚拟地址
 #define MAXVA (1L << 38)
 
 // --- 5. 关键寄存器操作 (这是你之前缺少的！) ---
 
+// sstatus 寄存器
+#define SSTATUS_SIE  (1L << 1)  // S 模式全局中断使能
+#define SSTATUS_SPIE (1L << 5)  // 陷入前的 SIE
+#define SSTATUS_SPP  (1L << 8)  // 陷入前的特权级，1 为 S 模式
+#define SSTATUS_VS_MASK    (3L << 9)  // 向量扩展状态，未实现 V 扩展时恒为0
+#define SSTATUS_VS_INITIAL (1L << 9)
+
+static inline uint64 r_sstatus() {
+  uint64 x;
+  asm volatile("csrr %0, sstatus" : "=r" (x) );
+  return x;
+}
+
+static inline void w_sstatus(uint64 x) {
+  asm volatile("csrw sstatus, %0" : : "r" (x));
+}
+
+// sie 寄存器：各类 S 模式中断的使能位
+#define SIE_SSIE (1L << 1)  // 软件中断
+#define SIE_STIE (1L << 5)  // 定时器中断
+#define SIE_SEIE (1L << 9)  // 外部中断（PLIC）
+
+static inline uint64 r_sie() {
+  uint64 x;
+  asm volatile("csrr %0, sie" : "=r" (x) );
+  return x;
+}
+
+static inline void w_sie(uint64 x) {
+  asm volatile("csrw sie, %0" : : "r" (x));
+}
+
+// sip 寄存器：挂起的 S 模式中断，只有 SSIP 可由软件清除
+#define SIP_SSIP (1L << 1)
+
+static inline uint64 r_sip() {
+  uint64 x;
+  asm volatile("csrr %0, sip" : "=r" (x) );
+  return x;
+}
+
+static inline void w_sip(uint64 x) {
+  asm volatile("csrw sip, %0" : : "r" (x));
+}
+
+// 停机等待中断：sie 中开启的中断挂起时返回，与 sstatus.SIE 无关
+static inline void wfi() {
+  asm volatile("wfi");
+}
+
+// 开启 S 模式中断
+static inline void intr_on() {
+  w_sstatus(r_sstatus() | SSTATUS_SIE);
+}
+
+// 关闭 S 模式中断
+static inline void intr_off() {
+  w_sstatus(r_sstatus() & ~SSTATUS_SIE);
+}
+
+// 当前是否开启中断
+static inline int intr_get() {
+  return (r_sstatus() & SSTATUS_SIE) != 0;
+}
+
+// 陷入相关 CSR
+// scause 最高位为1表示中断，否则为异常
+#define SCAUSE_INTR             (1UL << 63)
+#define SCAUSE_SSOFT            (SCAUSE_INTR | 1)  // S 模式软件中断
+#define SCAUSE_STIMER           (SCAUSE_INTR | 5)  // S 模式定时器中断
+#define SCAUSE_SEXT             (SCAUSE_INTR | 9)  // S 模式外部中断
+#define SCAUSE_INST_PAGE_FAULT  12
+#define SCAUSE_LOAD_PAGE_FAULT  13
+#define SCAUSE_STORE_PAGE_FAULT 15
+
+static inline uint64 r_scause() {
+  uint64 x;
+  asm volatile("csrr %0, scause" : "=r" (x) );
+  return x;
+}
+
+static inline uint64 r_stval() {
+  uint64 x;
+  asm volatile("csrr %0, stval" : "=r" (x) );
+  return x;
+}
+
+static inline uint64 r_sepc() {
+  uint64 x;
+  asm volatile("csrr %0, sepc" : "=r" (x) );
+  return x;
+}
+
+static inline void w_sepc(uint64 x) {
+  asm volatile("csrw sepc, %0" : : "r" (x));
+}
+
+static inline void w_stvec(uint64 x) {
+  asm volatile("csrw stvec, %0" : : "r" (x));
+}
+
 // 读取 satp
 static inline uint64 r_satp() {
   uint64 x;
@@ -51,6 +161,35 @@ static inline void sfence_vma() {
   asm volatile("sfence.vma zero, zero");
 }
 
+// 只刷新虚拟地址 va 所在页的 TLB 项
+static inline void sfence_vma_va(uint64 va) {
+  asm volatile("sfence.vma %0, zero" : : "r" (va) : "memory");
+}
+
+// 只刷新 asid 地址空间中的 TLB 项（全局映射除外）
+static inline void sfence_vma_asid(uint64 asid) {
+  asm volatile("sfence.vma zero, %0" : : "r" (asid) : "memory");
+}
+
+// 只刷新 asid 地址空间中虚拟地址 va 所在页的 TLB 项
+static inline void sfence_vma_va_asid(uint64 va, uint64 asid) {
+  asm volatile("sfence.vma %0, %1" : : "r" (va), "r" (asid) : "memory");
+}
+
+// 读取 time 计数器（由 mtime 驱动，频率见 TIMEBASE_FREQ）
+static inline uint64 r_time() {
+  uint64 x;
+  asm volatile("csrr %0, time" : "=r" (x) );
+  return x;
+}
+
+// 读取 cycle 计数器（需要 M 模式固件在 mcounteren 中开放，OpenSBI 默认开放）
+static inline uint64 r_cycle() {
+  uint64 x;
+  asm volatile("rdcycle %0" : "=r" (x) );
+  return x;
+}
+
 // 读取 tp (线程指针/Core ID)
 static inline uint64 r_tp() {
   uint64 x;
@@ -61,6 +200,10 @@ static inline uint64 r_tp() {
 // --- 6. SATP 构造宏 ---
 #define SATP_SV39 (8L << 60)
 #define MAKE_SATP(pagetable) (SATP_SV39 | (((uint64)pagetable) >> 12))
+#define SATP_ASID_SHIFT 44
+#define SATP_ASID_MASK  0xFFFFL
+#define SATP2PT(satp) ((pagetable_t)(((satp) & ((1L << SATP_ASID_SHIFT) - 1)) << 12))
+#define MAKE_SATP_ASID(pagetable, asid) (MAKE_SATP(pagetable) | (((uint64)(asid) & SATP_ASID_MASK) << SATP_ASID_SHIFT))
 
 // --- 7. 类型定义 ---
 typedef uint64 pte_t;
@@ -0,0 +1,52 @@
+// SBI (Supervisor Binary Interface) 调用封装
+// 通过 ecall 陷入 M 模式的 OpenSBI 固件
+#include "types.h"
+#include "sbi.h"
+
+struct sbiret {
+  long error;
+  long value;
+};
+
+static struct sbiret sbi_call(uint64 ext, uint64 fid, uint64 arg0, uint64 arg1,
+                              uint64 arg2, uint64 arg3, uint64 arg4) {
+  register uint64 a0 asm("a0") = arg0;
+  register uint64 a1 asm("a1") = arg1;
+  register uint64 a2 asm("a2") = arg2;
+  register uint64 a3 asm("a3") = arg3;
+  register uint64 a4 asm("a4") = arg4;
+  register uint64 a6 asm("a6") = fid;
+  register uint64 a7 asm("a7") = ext;
+  asm volatile("ecall"
+               : "+r" (a0), "+r" (a1)
+               : "r" (a2), "r" (a3), "r" (a4), "r" (a6), "r" (a7)
+               : "memory");
+  struct sbiret ret = { (long)a0, (long)a1 };
+  return ret;
+}
+
+long sbi_hart_start(uint64 hartid, uint64 start_addr, uint64 opaque) {
+  return sbi_call(SBI_EXT_HSM, 0, hartid, start_addr, opaque, 0, 0).error;
+}
+
+long sbi_hart_get_status(uint64 hartid) {
+  struct sbiret ret = sbi_call(SBI_EXT_HSM, 2, hartid, 0, 0, 0, 0);
+  return ret.error ? ret.error : ret.value;
+}
+
+long sbi_remote_sfence_vma(uint64 hart_mask, uint64 hart_mask_base, uint64 start, uint64 size) {
+  return sbi_call(SBI_EXT_RFENCE, 1, hart_mask, hart_mask_base, start, size, 0).error;
+}
+
+long sbi_remote_sfence_vma_asid(uint64 hart_mask, uint64 hart_mask_base, uint64 start, uint64 size,
+                                uint64 asid) {
+  return sbi_call(SBI_EXT_RFENCE, 2, hart_mask, hart_mask_base, start, size, asid).error;
+}
+
+long sbi_set_timer(uint64 stime_value) {
+  return sbi_call(SBI_EXT_TIME, 0, stime_value, 0, 0, 0, 0).error;
+}
+
+long sbi_send_ipi(uint64 hart_mask, uint64 hart_mask_base) {
+  return sbi_call(SBI_EXT_IPI, 0, hart_mask, hart_mask_base, 0, 0, 0).error;
+}
@@ -0,0 +1,67 @@
+#ifndef SBI_H
+#define SBI_H
+
+#include "types.h"
+
+// SBI 扩展号 (EID)
+#define SBI_EXT_HSM    0x48534D    // "HSM" hart 状态管理扩展
+#define SBI_EXT_RFENCE 0x52464E43  // "RFNC" 远程栅栏扩展
+#define SBI_EXT_TIME   0x54494D45  // "TIME" 定时器扩展
+#define SBI_EXT_IPI    0x735049    // "sPI" 核间中断扩展
+
+// SBI 返回的错误码
+#define SBI_SUCCESS               0
+#define SBI_ERR_FAILED           -1
+#define SBI_ERR_NOT_SUPPORTED    -2
+#define SBI_ERR_INVALID_PARAM    -3
+#define SBI_ERR_ALREADY_AVAILABLE -6
+
+// HSM hart 状态
+#define SBI_HSM_STARTED        0
+#define SBI_HSM_STOPPED        1
+#define SBI_HSM_START_PENDING  2
+
+/**
+ * 通过 HSM 扩展启动一个处于停止状态的 hart
+ * @param hartid 目标 hart
+ * @param start_addr 目标 hart 开始执行的物理地址（S 模式、关分页）
+ * @param opaque 启动时通过 a1 传给目标 hart 的参数
+ * @return SBI 错误码，成功返回 SBI_SUCCESS
+ */
+long sbi_hart_start(uint64 hartid, uint64 start_addr, uint64 opaque);
+
+/**
+ * 查询 hart 的 HSM 状态
+ * @return 成功返回 SBI_HSM_* 状态，失败返回负的 SBI 错误码
+ */
+long sbi_hart_get_status(uint64 hartid);
+
+/**
+ * 让 hart_mask 指定的 hart 刷新 [start, start+size) 的 TLB 项
+ * @param hart_mask 目标 hart 位图，第 i 位对应 hartid = hart_mask_base + i
+ * @param size 为 (uint64)-1 时刷新全部地址
+ * @return SBI 错误码
+ */
+long sbi_remote_sfence_vma(uint64 hart_mask, uint64 hart_mask_base, uint64 start, uint64 size);
+
+/**
+ * 与 sbi_remote_sfence_vma 相同，但只刷新属于 asid 的 TLB 项
+ * @return SBI 错误码
+ */
+long sbi_remote_sfence_vma_asid(uint64 hart_mask, uint64 hart_mask_base, uint64 start, uint64 size,
+                                uint64 asid);
+
+/**
+ * 设置当前 hart 的下一次定时器中断时间，同时清除已挂起的定时器中断
+ * @param stime_value 以 time CSR 计数表示的绝对时间，(uint64)-1 表示取消
+ * @return SBI 错误码
+ */
+long sbi_set_timer(uint64 stime_value);
+
+/**
+ * 向 hart_mask 指定的 hart 发送 S 模式软件中断（置位其 sip.SSIP）
+ * @return SBI 错误码
+ */
+long sbi_send_ipi(uint64 hart_mask, uint64 hart_mask_base);
+
+#endif
@@ -0,0 +1,315 @@
+// slab 对象分配器
+// 每个缓存管理同一大小的对象，对象存放在由伙伴系统分配的 slab 块中。
+// slab 块起始处是 slab 首部和空闲对象索引链表，之后是对象区；
+// 块内每一页的私有字都指向 slab 首部，因此释放对象时可 O(1) 找到所属 slab。
+#include "types.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "kalloc.h"
+#include "slab.h"
+#include "printf.h"
+
+#define SLAB_MIN_SHIFT 4    // 最小通用对象 16B
+#define SLAB_MAX_SHIFT 11   // 最大通用对象 2KB
+#define NKMALLOC       (SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+#define SLAB_MAX_ORDER 3    // 单个 slab 最多占 2^3 页
+#define SLAB_MIN_OBJS  8    // 选择 slab 大小时希望每个 slab 至少容纳的对象数
+#define NSLABCACHE     32   // 缓存描述符数量上限
+#define SLAB_FREE_END  0xFFFF
+
+// slab 首部，位于 slab 块的起始处
+struct slab {
+  struct kmem_cache *cache; // 所属缓存
+  struct slab *next;        // 所在链表（partial / full / empty）
+  struct slab *prev;
+  uint16 inuse;             // 已分配对象数
+  uint16 free_head;         // 第一个空闲对象的索引
+  uint16 free_next[];       // 空闲索引链表：free_next[i] 是 i 之后的空闲对象
+};
+
+struct kmem_cache {
+  struct spinlock lock;
+  const char *name;
+  uint size;                // 对齐后的对象大小
+  int order;                // 每个 slab 占 2^order 页
+  uint objs;                // 每个 slab 的对象数
+  uint offset;              // 对象区相对 slab 起始的偏移
+  void (*ctor)(void *);     // 构造函数，可为0
+
+  struct slab *partial;     // 部分对象已分配的 slab
+  struct slab *full;        // 对象全部分配的 slab
+  struct slab *empty;       // 对象全部空闲的 slab
+  uint nr_slabs;            // slab 总数
+  uint nr_empty;            // 空闲 slab 数
+  uint reserve_slabs;       // 预留 slab 数，不会被自动回收
+
+  uint64 active;            // 在用对象数
+  uint64 allocs;            // 累计分配次数
+  uint64 frees;             // 累计释放次数
+};
+
+static struct spinlock cache_table_lock;
+static struct kmem_cache caches[NSLABCACHE];
+static int ncaches;
+
+static struct kmem_cache *kmalloc_caches[NKMALLOC];
+static const char *kmalloc_names[NKMALLOC] = {
+  "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+  "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048",
+};
+
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((uint64)(a) - 1))
+
+static void slab_list_add(struct slab **head, struct slab *s) {
+  s->prev = 0;
+  s->next = *head;
+  if (*head)
+    (*head)->prev = s;
+  *head = s;
+}
+
+static void slab_list_remove(struct slab **head, struct slab *s) {
+  if (s->prev)
+    s->prev->next = s->next;
+  else
+    *head = s->next;
+  if (s->next)
+    s->next->prev = s->prev;
+}
+
+// 选择 slab 的阶数与对象区布局，尽量让每个 slab 容纳 SLAB_MIN_OBJS 个以上对象
+static int cache_layout(struct kmem_cache *c) {
+  // 对象区起始按对象大小对齐，最多按 64 字节（缓存行）对齐
+  uint align = c->size >= 64 ? 64 : (c->size >= 16 ? 16 : 8);
+
+  for (int order = 0; order <= SLAB_MAX_ORDER; order++) {
+    uint bytes = PGSIZE << order;
+    uint objs = (bytes - sizeof(struct slab)) / (c->size + sizeof(uint16));
+    uint offset = 0;
+    while (objs > 0) {
+      offset = ALIGN_UP(sizeof(struct slab) + objs * sizeof(uint16), align);
+      if (offset + objs * c->size <= bytes)
+        break;
+      objs--;
+    }
+    if (objs >= SLAB_MIN_OBJS || (order == SLAB_MAX_ORDER && objs > 0)) {
+      c->order = order;
+      c->objs = objs;
+      c->offset = offset;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+// 新建一个 slab：初始化空闲链表、调用构造函数、标记页的私有字
+static struct slab *slab_new(struct kmem_cache *c) {
+  struct slab *s = (struct slab *)buddy_alloc(c->order);
+  if (s == 0)
+    return 0;
+
+  s->cache = c;
+  s->next = s->prev = 0;
+  s->inuse = 0;
+  s->free_head = 0;
+  for (uint i = 0; i < c->objs; i++)
+    s->free_next[i] = (i + 1 < c->objs) ? i + 1 : SLAB_FREE_END;
+
+  if (c->ctor) {
+    for (uint i = 0; i < c->objs; i++)
+      c->ctor((char *)s + c->offset + i * c->size);
+  }
+
+  for (int i = 0; i < (1 << c->order); i++)
+    kpage_set_private((char *)s + i * PGSIZE, (uint64)s);
+  return s;
+}
+
+// 将 slab 归还伙伴系统
+static void slab_destroy(struct kmem_cache *c, struct slab *s) {
+  for (int i = 0; i < (1 << c->order); i++)
+    kpage_set_private((char *)s + i * PGSIZE, 0);
+  buddy_free(s);
+}
+
+struct kmem_cache *kmem_cache_create(const char *name, uint size, void (*ctor)(void *)) {
+  if (size == 0)
+    return 0;
+
+  acquire(&cache_table_lock);
+  if (ncaches >= NSLABCACHE) {
+    release(&cache_table_lock);
+    return 0;
+  }
+  struct kmem_cache *c = &caches[ncaches];
+
+  c->name = name;
+  c->size = ALIGN_UP(size, 8);
+  c->ctor = ctor;
+  c->partial = c->full = c->empty = 0;
+  c->nr_slabs = c->nr_empty = c->reserve_slabs = 0;
+  c->active = c->allocs = c->frees = 0;
+  if (cache_layout(c) < 0) {
+    release(&cache_table_lock);
+    return 0; // 对象过大
+  }
+  initlock(&c->lock, (char *)name);
+  ncaches++;
+  release(&cache_table_lock);
+  return c;
+}
+
+void *kmem_cache_alloc(struct kmem_cache *c) {
+  acquire(&c->lock);
+  struct slab *s = c->partial;
+  if (s == 0 && (s = c->empty) != 0) {
+    slab_list_remove(&c->empty, s);
+    c->nr_empty--;
+    slab_list_add(&c->partial, s);
+  }
+  if (s == 0) {
+    // 在锁外向伙伴系统申请新 slab
+    release(&c->lock);
+    s = slab_new(c);
+    if (s == 0)
+      return 0;
+    acquire(&c->lock);
+    c->nr_slabs++;
+    slab_list_add(&c->partial, s);
+  }
+
+  uint idx = s->free_head;
+  s->free_head = s->free_next[idx];
+  s->inuse++;
+  if (s->inuse == c->objs) {
+    slab_list_remove(&c->partial, s);
+    slab_list_add(&c->full, s);
+  }
+  c->active++;
+  c->allocs++;
+  release(&c->lock);
+
+  return (char *)s + c->offset + idx * c->size;
+}
+
+void kmem_cache_free(struct kmem_cache *c, void *obj) {
+  if (obj == 0)
+    return;
+
+  struct slab *s = (struct slab *)kpage_private(obj);
+  if (s == 0 || s->cache != c)
+    panic("kmem_cache_free: object not from this cache");
+  uint idx = ((char *)obj - (char *)s - c->offset) / c->size;
+
+  struct slab *victim = 0;
+  acquire(&c->lock);
+  if (s->inuse == c->objs) {
+    slab_list_remove(&c->full, s);
+    slab_list_add(&c->partial, s);
+  }
+  s->free_next[idx] = s->free_head;
+  s->free_head = idx;
+  s->inuse--;
+  c->active--;
+  c->frees++;
+
+  if (s->inuse == 0) {
+    // 至多保留一个空闲 slab（或预留的 slab），避免在边界处反复申请/归还
+    slab_list_remove(&c->partial, s);
+    if (c->nr_empty > 0 && c->nr_slabs > c->reserve_slabs) {
+      victim = s;
+      c->nr_slabs--;
+    } else {
+      slab_list_add(&c->empty, s);
+      c->nr_empty++;
+    }
+  }
+  release(&c->lock);
+
+  if (victim)
+    slab_destroy(c, victim);
+}
+
+int kmem_cache_reserve(struct kmem_cache *c, int nobjs) {
+  uint need = (nobjs + c->objs - 1) / c->objs;
+
+  acquire(&c->lock);
+  while (c->nr_slabs < need) {
+    release(&c->lock);
+    struct slab *s = slab_new(c);
+    if (s == 0)
+      return -1;
+    acquire(&c->lock);
+    slab_list_add(&c->empty, s);
+    c->nr_empty++;
+    c->nr_slabs++;
+  }
+  if (need > c->reserve_slabs)
+    c->reserve_slabs = need;
+  release(&c->lock);
+  return 0;
+}
+
+void kmem_cache_shrink(struct kmem_cache *c) {
+  struct slab *victims = 0;
+
+  acquire(&c->lock);
+  while (c->empty && c->nr_slabs > c->reserve_slabs) {
+    struct slab *s = c->empty;
+    slab_list_remove(&c->empty, s);
+    c->nr_empty--;
+    c->nr_slabs--;
+    slab_list_add(&victims, s);
+  }
+  release(&c->lock);
+
+  while (victims) {
+    struct slab *s = victims;
+    victims = s->next;
+    slab_destroy(c, s);
+  }
+}
+
+void slab_init(void) {
+  initlock(&cache_table_lock, "slab_caches");
+  for (int i = 0; i < NKMALLOC; i++) {
+    kmalloc_caches[i] = kmem_cache_create(kmalloc_names[i], 1u << (SLAB_MIN_SHIFT + i), 0);
+    if (kmalloc_caches[i] == 0)
+      panic("slab_init");
+  }
+}
+
+void *kmalloc(uint size) {
+  if (size == 0)
+    return 0;
+
+  // 大对象直接按页分配，返回页对齐地址，其页私有字为0
+  if (size > (1u << SLAB_MAX_SHIFT))
+    return kalloc_pages((size + PGSIZE - 1) / PGSIZE);
+
+  int shift = SLAB_MIN_SHIFT;
+  while ((1u << shift) < size)
+    shift++;
+  return kmem_cache_alloc(kmalloc_caches[shift - SLAB_MIN_SHIFT]);
+}
+
+void kmfree(void *obj) {
+  if (obj == 0)
+    return;
+
+  struct slab *s = (struct slab *)kpage_private(obj);
+  if (s)
+    kmem_cache_free(s->cache, obj);
+  else
+    kfree(obj); // kmalloc 按页分配的大对象
+}
+
+void slab_dump(void) {
+  printf("=== Slab Caches ===\n");
+  for (int i = 0; i < ncaches; i++) {
+    struct kmem_cache *c = &caches[i];
+    printf("%s: size=%d objs/slab=%d order=%d slabs=%d active=%d allocs=%d frees=%d\n",
+           c->name, c->size, c->objs, c->order, c->nr_slabs,
+           (int)c->active, (int)c->allocs, (int)c->frees);
+  }
+}
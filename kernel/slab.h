@@ -0,0 +1,67 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+// slab 对象分配器头文件
+// 在伙伴系统之上按对象大小组织缓存，用于小于一页的内核对象
+
+#include "types.h"
+
+struct kmem_cache;
+
+/**
+ * 初始化 slab 分配器，创建 16B ~ 2KB 的 kmalloc 通用缓存
+ * @note 必须在 kinit 之后调用
+ */
+void slab_init(void);
+
+/**
+ * 创建一个具名对象缓存
+ * @param name 缓存名称（用于统计输出，须为常量字符串）
+ * @param size 对象大小（字节），会向上对齐到 8 字节
+ * @param ctor 构造函数，新 slab 建立时对每个对象调用一次，可为0
+ * @return 成功返回缓存指针，失败返回0
+ * @note 有构造函数的缓存，对象释放时须恢复到构造后的状态
+ */
+struct kmem_cache *kmem_cache_create(const char *name, uint size, void (*ctor)(void *));
+
+/**
+ * 从缓存中分配一个对象，O(1)
+ * @return 成功返回对象指针，失败返回0
+ */
+void *kmem_cache_alloc(struct kmem_cache *cache);
+
+/**
+ * 将对象归还到它所属的缓存，O(1)
+ */
+void kmem_cache_free(struct kmem_cache *cache, void *obj);
+
+/**
+ * 预先建立足够容纳 nobjs 个对象的 slab，且这些 slab 不会被自动回收
+ * @return 成功返回0，内存不足返回-1
+ * @note 用于按 NPROC / NBUF / NINODE 等上限预留对象
+ */
+int kmem_cache_reserve(struct kmem_cache *cache, int nobjs);
+
+/**
+ * 将缓存中所有空闲 slab（预留部分除外）归还伙伴系统
+ */
+void kmem_cache_shrink(struct kmem_cache *cache);
+
+/**
+ * 通用小对象分配，按 2 的幂大小分级，内容未定义
+ * @param size 请求字节数，超过 2KB 时直接按页分配
+ * @return 成功返回对象指针，失败或 size 为0时返回0
+ */
+void *kmalloc(uint size);
+
+/**
+ * 释放 kmalloc 分配的对象
+ */
+void kmfree(void *obj);
+
+/**
+ * 打印所有缓存的使用统计
+ */
+void slab_dump(void);
+
+#endif // SLAB_H
@@ -1,7 +1,41 @@
-#include <stdint.h>
+// 基于时间轮定时器的睡眠
+// time CSR 以 TIMEBASE_FREQ 的固定频率计数，与宿主机速度无关
+#include "types.h"
+#include "riscv.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "param.h"
+#include "timer.h"
+#include "sleep.h"
+
+void timer_intr(void) {
+  timer_run();
+}
+
+uint64 uptime_us(void) {
+  return r_time() / (TIMEBASE_FREQ / 1000000);
+}
+
+static void sleep_wakeup(struct timer *t) {
+  *(volatile int *)t->arg = 1;
+}
 
-// 基于 CPU 空循环的简单延时（单位：毫秒）
 void sleep(uint32_t ms) {
-    volatile uint32_t cycles = ms * 500000;
-    while (cycles--);
-}
\ No newline at end of file
+  volatile int done = 0;
+  struct timer t;
+  timer_init(&t, sleep_wakeup, (void *)&done);
+
+  // 向上取整到 jiffy，保证至少睡眠 ms 毫秒
+  uint64 tick = TIMEBASE_FREQ / HZ;
+  timer_add(&t, (r_time() + (uint64)ms * (TIMEBASE_FREQ / 1000) + tick - 1) / tick);
+
+  while (!done) {
+    // 关中断检查并停机：到期的定时器中断保持挂起，wfi 会立即返回
+    push_off();
+    if (!done)
+      wfi();
+    pop_off();
+    // 开中断的调用者已由中断处理推进时间轮；关中断的调用者（如从核）在这里自行推进
+    timer_run();
+  }
+}
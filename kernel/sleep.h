@@ -2,6 +2,23 @@
 #define SLEEP_H
 
 #include"types.h"
+
+// 基于 time CSR 与 SBI 定时器的时间服务
+// S 模式不能直接写 CLINT 的 mtimecmp，定时器通过 SBI set_timer 设置，由 timer.c 的时间轮统一管理
+
+/**
+ * 定时器中断处理：运行时间轮中已到期的定时器
+ */
+void timer_intr(void);
+
+/**
+ * 自启动以来经过的微秒数（由 time CSR 换算）
+ */
+uint64 uptime_us(void);
+
+/**
+ * 睡眠 ms 毫秒：向时间轮添加定时器后执行 wfi 停机，不占用 CPU
+ */
 void sleep(uint32_t ms);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,135 @@
+// 自旋锁实现
+// 默认使用 amoswap 的 test-and-test-and-set 锁；
+// 以 -DLOCK_TICKET 编译时使用票号锁，保证竞争下的公平性
+#include "types.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "cpu.h"
+#include "printf.h"
+
+// 所有已初始化锁组成的统计链表
+static struct spinlock *lockstat_head;
+
+void initlock(struct spinlock *lk, char *name) {
+  lk->name = name;
+  lk->locked = 0;
+  lk->ticket_next = 0;
+  lk->ticket_owner = 0;
+  lk->cpu = 0;
+  lk->acquires = 0;
+  lk->contended = 0;
+  lk->spins = 0;
+  lk->max_hold = 0;
+  lk->t_acquire = 0;
+
+  // 无锁地插入统计链表头部
+  struct spinlock *head;
+  do {
+    head = lockstat_head;
+    lk->stat_next = head;
+  } while (!__sync_bool_compare_and_swap(&lockstat_head, head, lk));
+}
+
+// 获取锁，自旋直到成功
+// 关中断以避免与本 hart 上的中断处理程序死锁
+void acquire(struct spinlock *lk) {
+  push_off();
+  if (holding(lk))
+    panic("acquire");
+
+  uint64 spins = 0;
+#ifdef LOCK_TICKET
+  uint ticket = __atomic_fetch_add(&lk->ticket_next, 1, __ATOMIC_RELAXED);
+  while (__atomic_load_n(&lk->ticket_owner, __ATOMIC_ACQUIRE) != ticket)
+    spins++;
+  lk->locked = 1;
+#else
+  // amoswap.w.aq；失败后只读等待，避免反复发起原子操作争抢缓存行
+  while (__sync_lock_test_and_set(&lk->locked, 1) != 0) {
+    do {
+      spins++;
+    } while (__atomic_load_n(&lk->locked, __ATOMIC_RELAXED) != 0);
+  }
+#endif
+
+  // 确保临界区内的访存不会被重排到获取锁之前
+  __sync_synchronize();
+
+  lk->cpu = mycpu();
+  lk->acquires++;
+  if (spins) {
+    lk->contended++;
+    lk->spins += spins;
+  }
+  lk->t_acquire = r_time();
+}
+
+// 释放锁
+void release(struct spinlock *lk) {
+  if (!holding(lk))
+    panic("release");
+
+  uint64 held = r_time() - lk->t_acquire;
+  if (held > lk->max_hold)
+    lk->max_hold = held;
+
+  lk->cpu = 0;
+
+  // 确保临界区内的访存在释放锁之前全部完成
+  __sync_synchronize();
+
+#ifdef LOCK_TICKET
+  lk->locked = 0;
+  __atomic_store_n(&lk->ticket_owner, lk->ticket_owner + 1, __ATOMIC_RELEASE);
+#else
+  __sync_lock_release(&lk->locked);
+#endif
+
+  pop_off();
+}
+
+// 当前 hart 是否持有该锁，调用时须已关中断
+int holding(struct spinlock *lk) {
+  return lk->locked && lk->cpu == mycpu();
+}
+
+// push_off/pop_off 与 intr_off/intr_on 类似，但可以嵌套：
+// 两次 push_off 需要两次 pop_off 才能恢复；若最初中断是关闭的，则保持关闭
+void push_off(void) {
+  int old = intr_get();
+
+  intr_off();
+  if (mycpu()->noff == 0)
+    mycpu()->intena = old;
+  mycpu()->noff += 1;
+}
+
+void pop_off(void) {
+  struct cpu *c = mycpu();
+  if (intr_get())
+    panic("pop_off - interruptible");
+  if (c->noff < 1)
+    panic("pop_off");
+  c->noff -= 1;
+  if (c->noff == 0 && c->intena)
+    intr_on();
+}
+
+// 打印所有锁的竞争统计，最长持有时间以 time 计数为单位
+void lockstat_dump(void) {
+  printf("=== Lock Statistics ===\n");
+  for (struct spinlock *lk = lockstat_head; lk; lk = lk->stat_next) {
+    printf("%s: acquires=%u contended=%u spins=%u max_hold=%u ticks\n",
+           lk->name, (uint)lk->acquires, (uint)lk->contended,
+           (uint)lk->spins, (uint)lk->max_hold);
+  }
+}
+
+void lockstat_reset(void) {
+  for (struct spinlock *lk = lockstat_head; lk; lk = lk->stat_next) {
+    lk->acquires = 0;
+    lk->contended = 0;
+    lk->spins = 0;
+    lk->max_hold = 0;
+  }
+}
@@ -1,15 +1,31 @@
 #ifndef SPINLOCK_H
 #define SPINLOCK_H
 
+#include "types.h"
+
+struct cpu;
+
 // spinlock.h
 // Mutual exclusion lock.
 struct spinlock {
   uint locked;       // 锁状态：0表示未上锁，1表示已上锁
 
+  // 票号锁字段（仅在以 LOCK_TICKET 编译时使用，保证按到达顺序获取）
+  uint ticket_next;  // 下一个发放的票号
+  uint ticket_owner; // 当前允许持有锁的票号
+
   // 用于调试的字段：
   char *name;        // 锁的名称，便于调试
   struct cpu *cpu;   // 当前持有该锁的CPU的指针
   uint pcs[10];      // 获取该锁时的调用栈（程序计数器数组）
+
+  // 竞争统计（在持有锁时更新，无需额外同步）
+  uint64 acquires;   // 获取次数
+  uint64 contended;  // 需要自旋等待的获取次数
+  uint64 spins;      // 累计自旋次数
+  uint64 max_hold;   // 最长持有时间（time 计数）
+  uint64 t_acquire;  // 本次获取时的时间戳
+  struct spinlock *stat_next; // 统计链表，用于 lockstat_dump 遍历所有已命名的锁
 };
 
 // 函数声明
@@ -22,4 +38,8 @@ int holding(struct spinlock*);          // 检查当前CPU是否持有该锁（
 void push_off(void); // 禁用中断，并记录之前的中断状态（可嵌套调用）
 void pop_off(void);  // 恢复之前的中断状态（与 push_off 配对使用）
 
-#endif
\ No newline at end of file
+// 锁竞争统计
+void lockstat_dump(void);  // 打印所有已初始化锁的统计信息
+void lockstat_reset(void); // 清零所有锁的统计信息
+
+#endif
@@ -19,11 +19,154 @@ char *strcpy(char *dst, const char *src) {
     return dst;
 }
 
+// 按字访问的内存操作：先按字节处理到 8 字节对齐，主体每次 64 字节（8 个 ld/sd）展开，
+// 剩余的整字与尾部字节分别处理。RISC-V 上未对齐的字访问会陷入固件模拟，
+// 所以源与目标对齐余数不同时退回按字节处理。
+typedef uint64 __attribute__((__may_alias__)) word_t;
+
+#define WORD_SIZE  sizeof(word_t)
+#define WORD_MASK  (WORD_SIZE - 1)
+#define BLOCK_SIZE (8 * WORD_SIZE)
+
 void *memset(void *s, int c, size_t n) {
     unsigned char *p = (unsigned char *)s;
     unsigned char val = (unsigned char)c;
+
+    while (n > 0 && ((uint64)p & WORD_MASK)) {
+        *p++ = val;
+        n--;
+    }
+
+    word_t w = val * 0x0101010101010101UL;
+    word_t *wp = (word_t *)p;
+    while (n >= BLOCK_SIZE) {
+        wp[0] = w; wp[1] = w; wp[2] = w; wp[3] = w;
+        wp[4] = w; wp[5] = w; wp[6] = w; wp[7] = w;
+        wp += 8;
+        n -= BLOCK_SIZE;
+    }
+    while (n >= WORD_SIZE) {
+        *wp++ = w;
+        n -= WORD_SIZE;
+    }
+
+    p = (unsigned char *)wp;
     while (n--) {
         *p++ = val;
     }
     return s;
-}
\ No newline at end of file
+}
+
+// 从前往后复制，目标在源之前时区间可以重叠
+static void copy_forward(unsigned char *d, const unsigned char *s, size_t n) {
+    if ((((uint64)d ^ (uint64)s) & WORD_MASK) == 0) {
+        while (n > 0 && ((uint64)d & WORD_MASK)) {
+            *d++ = *s++;
+            n--;
+        }
+        word_t *wd = (word_t *)d;
+        const word_t *ws = (const word_t *)s;
+        while (n >= BLOCK_SIZE) {
+            word_t w0 = ws[0], w1 = ws[1], w2 = ws[2], w3 = ws[3];
+            word_t w4 = ws[4], w5 = ws[5], w6 = ws[6], w7 = ws[7];
+            wd[0] = w0; wd[1] = w1; wd[2] = w2; wd[3] = w3;
+            wd[4] = w4; wd[5] = w5; wd[6] = w6; wd[7] = w7;
+            wd += 8;
+            ws += 8;
+            n -= BLOCK_SIZE;
+        }
+        while (n >= WORD_SIZE) {
+            *wd++ = *ws++;
+            n -= WORD_SIZE;
+        }
+        d = (unsigned char *)wd;
+        s = (const unsigned char *)ws;
+    }
+    while (n--) {
+        *d++ = *s++;
+    }
+}
+
+// 从后往前复制，目标在源之后时区间可以重叠
+static void copy_backward(unsigned char *d, const unsigned char *s, size_t n) {
+    d += n;
+    s += n;
+    if ((((uint64)d ^ (uint64)s) & WORD_MASK) == 0) {
+        while (n > 0 && ((uint64)d & WORD_MASK)) {
+            *--d = *--s;
+            n--;
+        }
+        word_t *wd = (word_t *)d;
+        const word_t *ws = (const word_t *)s;
+        while (n >= BLOCK_SIZE) {
+            wd -= 8;
+            ws -= 8;
+            word_t w0 = ws[0], w1 = ws[1], w2 = ws[2], w3 = ws[3];
+            word_t w4 = ws[4], w5 = ws[5], w6 = ws[6], w7 = ws[7];
+            wd[7] = w7; wd[6] = w6; wd[5] = w5; wd[4] = w4;
+            wd[3] = w3; wd[2] = w2; wd[1] = w1; wd[0] = w0;
+            n -= BLOCK_SIZE;
+        }
+        while (n >= WORD_SIZE) {
+            *--wd = *--ws;
+            n -= WORD_SIZE;
+        }
+        d = (unsigned char *)wd;
+        s = (const unsigned char *)ws;
+    }
+    while (n--) {
+        *--d = *--s;
+    }
+}
+
+// 复制内存，源与目标区间可以重叠
+void *memmove(void *dst, const void *src, size_t n) {
+    const unsigned char *s = (const unsigned char *)src;
+    unsigned char *d = (unsigned char *)dst;
+    if (s < d && s + n > d) {
+        // 目标在源之后且重叠，从后往前复制
+        copy_backward(d, s, n);
+    } else {
+        copy_forward(d, s, n);
+    }
+    return dst;
+}
+
+// 复制内存，区间不重叠
+void *memcpy(void *dst, const void *src, size_t n) {
+    copy_forward((unsigned char *)dst, (const unsigned char *)src, n);
+    return dst;
+}
+
+// 比较内存，返回第一个不同字节之差（按无符号比较）
+int memcmp(const void *a, const void *b, size_t n) {
+    const unsigned char *p = (const unsigned char *)a;
+    const unsigned char *q = (const unsigned char *)b;
+
+    if ((((uint64)p ^ (uint64)q) & WORD_MASK) == 0) {
+        while (n > 0 && ((uint64)p & WORD_MASK)) {
+            if (*p != *q)
+                return *p - *q;
+            p++;
+            q++;
+            n--;
+        }
+        // 整字相等时跳过，遇到不同的字再逐字节找出差异
+        const word_t *wp = (const word_t *)p;
+        const word_t *wq = (const word_t *)q;
+        while (n >= WORD_SIZE && *wp == *wq) {
+            wp++;
+            wq++;
+            n -= WORD_SIZE;
+        }
+        p = (const unsigned char *)wp;
+        q = (const unsigned char *)wq;
+    }
+    while (n--) {
+        if (*p != *q)
+            return *p - *q;
+        p++;
+        q++;
+    }
+    return 0;
+}
@@ -6,5 +6,8 @@
 size_t strlen(const char *s);
 char *strcpy(char *dst, const char *src);
 void *memset(void *s, int c, size_t n);
+void *memmove(void *dst, const void *src, size_t n);
+void *memcpy(void *dst, const void *src, size_t n);
+int memcmp(const void *a, const void *b, size_t n);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,230 @@
+// 分层时间轮
+// 第 l 级的槽覆盖 64^l 个 jiffy，定时器按到期时刻与 clk 的距离放入能容纳它的最低一级。
+// clk 走到第 l 级某个槽的起点时，该槽中的定时器重新插入（级联）到更低的级别；
+// 第 0 级槽在 clk 等于其到期时刻时运行。
+// 每级用一个 64 位图记录非空槽，据此直接算出下一个需要处理的时刻，
+// clk 可以一次跳过任意长的空闲时间，硬件定时器也只设置为这个时刻。
+#include "types.h"
+#include "riscv.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "cpu.h"
+#include "sbi.h"
+#include "timer.h"
+
+#define TIMER_BITS   6
+#define TIMER_SLOTS  (1 << TIMER_BITS)
+#define TIMER_MASK   (TIMER_SLOTS - 1)
+#define TIMER_LEVELS 4
+#define LVL_SHIFT(l) ((l) * TIMER_BITS)
+#define TIMER_RANGE  (1UL << LVL_SHIFT(TIMER_LEVELS))  // 可直接表示的最远距离
+
+#define TICKS_PER_JIFFY (TIMEBASE_FREQ / HZ)
+#define NEVER ((uint64)-1)
+
+struct timer_base {
+  struct spinlock lock;
+  int inited;
+  uint64 clk;                           // 下一个待处理的 jiffy
+  uint64 armed;                         // 已设置给硬件的 jiffy，NEVER 表示未设置
+  uint64 occupied[TIMER_LEVELS];        // 非空槽位图
+  struct timer *slots[TIMER_LEVELS][TIMER_SLOTS];
+};
+
+static struct timer_base bases[NCPU];
+
+uint64 jiffies(void) {
+  return r_time() / TICKS_PER_JIFFY;
+}
+
+void timer_init(struct timer *t, void (*fn)(struct timer *), void *arg) {
+  t->next = 0;
+  t->pprev = 0;
+  t->expires = 0;
+  t->fn = fn;
+  t->arg = arg;
+  t->base = 0;
+}
+
+// 按到期时刻放入对应的级别与槽，需持有 base->lock
+static void enqueue(struct timer_base *base, struct timer *t) {
+  uint64 e = t->expires;
+  if (e < base->clk)
+    e = base->clk;  // 已过期：放入当前槽，下一次处理时运行
+  uint64 delta = e - base->clk;
+  if (delta >= TIMER_RANGE) {
+    // 超出时间轮范围：先放在最远处，级联时按真实到期时刻重新计算
+    delta = TIMER_RANGE - 1;
+    e = base->clk + delta;
+  }
+
+  int l = 0;
+  while (l < TIMER_LEVELS - 1 && delta >= (1UL << LVL_SHIFT(l + 1)))
+    l++;
+  int s = (e >> LVL_SHIFT(l)) & TIMER_MASK;
+
+  struct timer **head = &base->slots[l][s];
+  t->next = *head;
+  if (*head)
+    (*head)->pprev = &t->next;
+  *head = t;
+  t->pprev = head;
+  t->base = base;
+  base->occupied[l] |= 1UL << s;
+}
+
+// 从时间轮中摘除，需持有 base->lock
+static void dequeue(struct timer_base *base, struct timer *t) {
+  struct timer **pprev = t->pprev;
+  *pprev = t->next;
+  if (t->next)
+    t->next->pprev = pprev;
+  t->next = 0;
+  t->pprev = 0;
+  t->base = 0;
+
+  // 摘除的是槽头且槽已空时清除位图，槽头的地址即可算出级别与槽号
+  struct timer **first = &base->slots[0][0];
+  if (*pprev == 0 && pprev >= first && pprev < first + TIMER_LEVELS * TIMER_SLOTS) {
+    int i = pprev - first;
+    base->occupied[i / TIMER_SLOTS] &= ~(1UL << (i % TIMER_SLOTS));
+  }
+}
+
+// 下一个需要处理的时刻（>= clk）：某个第 0 级槽到期，或某个高层槽开始级联
+static uint64 next_event(struct timer_base *base) {
+  uint64 best = NEVER;
+  for (int l = 0; l < TIMER_LEVELS; l++) {
+    uint64 occ = base->occupied[l];
+    if (occ == 0)
+      continue;
+    int shift = LVL_SHIFT(l);
+    int cur = (base->clk >> shift) & TIMER_MASK;
+    uint64 rot = (base->clk >> (shift + TIMER_BITS)) << (shift + TIMER_BITS);
+
+    // 本轮中 >= cur 的槽；高层的当前槽若 clk 不在其起点，说明已经级联过，其中只有下一轮的定时器
+    uint64 ahead = occ & (~0UL << cur);
+    if (l > 0 && (base->clk & ((1UL << shift) - 1)) != 0)
+      ahead &= ~(1UL << cur);
+
+    uint64 t;
+    if (ahead)
+      t = rot + ((uint64)__builtin_ctzl(ahead) << shift);
+    else
+      t = rot + (1UL << (shift + TIMER_BITS)) + ((uint64)__builtin_ctzl(occ) << shift);
+    if (t < best)
+      best = t;
+  }
+  return best;
+}
+
+// 把硬件定时器设置为下一个需要处理的时刻，需持有 base->lock
+static void program(struct timer_base *base) {
+  uint64 next = next_event(base);
+  if (next == base->armed)
+    return;
+  base->armed = next;
+  sbi_set_timer(next == NEVER ? NEVER : next * TICKS_PER_JIFFY);
+}
+
+void timer_add(struct timer *t, uint64 expires) {
+  timer_cancel(t);
+
+  push_off();
+  struct timer_base *base = &bases[cpuid()];
+  acquire(&base->lock);
+  t->expires = expires;
+  enqueue(base, t);
+  // 只有新定时器比已设置的时刻更早时才需要重新设置硬件
+  if (next_event(base) < base->armed)
+    program(base);
+  release(&base->lock);
+  pop_off();
+}
+
+int timer_cancel(struct timer *t) {
+  struct timer_base *base = t->base;
+  if (base == 0)
+    return 0;
+
+  acquire(&base->lock);
+  int pending = t->base == base;
+  if (pending)
+    dequeue(base, t);
+  release(&base->lock);
+  // 硬件定时器不随之推迟：提前醒来一次的代价低于每次取消都调用 SBI
+  return pending;
+}
+
+// 级联第 l 级的槽 s：把其中的定时器重新插入更低的级别
+static void cascade(struct timer_base *base, int l, int s) {
+  struct timer *t = base->slots[l][s];
+  base->slots[l][s] = 0;
+  base->occupied[l] &= ~(1UL << s);
+  while (t) {
+    struct timer *next = t->next;
+    enqueue(base, t);
+    t = next;
+  }
+}
+
+void timer_run(void) {
+  push_off();
+  struct timer_base *base = &bases[cpuid()];
+  if (!base->inited) {
+    pop_off();
+    return;
+  }
+
+  uint64 now = jiffies();
+  acquire(&base->lock);
+  for (;;) {
+    uint64 clk = next_event(base);
+    if (clk > now) {
+      if (base->clk <= now)
+        base->clk = now + 1;
+      break;
+    }
+    base->clk = clk;
+
+    // clk 走到第 l 级槽的起点时级联该槽
+    for (int l = 1; l < TIMER_LEVELS; l++) {
+      if (clk & ((1UL << LVL_SHIFT(l)) - 1))
+        break;
+      cascade(base, l, (clk >> LVL_SHIFT(l)) & TIMER_MASK);
+    }
+
+    // 取下第 0 级当前槽，逐个在锁外运行回调
+    int s = clk & TIMER_MASK;
+    struct timer *list = base->slots[0][s];
+    base->slots[0][s] = 0;
+    base->occupied[0] &= ~(1UL << s);
+    base->clk = clk + 1;
+    while (list) {
+      struct timer *t = list;
+      list = t->next;
+      t->next = 0;
+      t->pprev = 0;
+      t->base = 0;
+      release(&base->lock);
+      t->fn(t);
+      acquire(&base->lock);
+    }
+  }
+  // 硬件定时器已到期（或被提前唤醒），无论如何都重新设置
+  base->armed = 0;
+  program(base);
+  release(&base->lock);
+  pop_off();
+}
+
+void timerinithart(void) {
+  struct timer_base *base = &bases[cpuid()];
+  initlock(&base->lock, "timer");
+  base->clk = jiffies();
+  base->armed = NEVER;
+  sbi_set_timer(NEVER);
+  base->inited = 1;
+  w_sie(r_sie() | SIE_STIE);
+}
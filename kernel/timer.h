@@ -0,0 +1,56 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+// 分层时间轮头文件
+// 每个 hart 一个时间轮，共 TIMER_LEVELS 级，每级 64 个槽，精度为 1/HZ 秒（一个 jiffy）。
+// 添加与取消都是 O(1)；高层槽在时钟走到其起点时级联到低层。
+// 时间轮是无节拍的：硬件定时器只设置为最近一个需要处理的时刻，没有周期性的时钟中断。
+
+#include "types.h"
+
+struct timer_base;
+
+struct timer {
+  struct timer *next;
+  struct timer **pprev;       // 指向前一个节点的 next（或槽头），用于 O(1) 摘除
+  uint64 expires;             // 到期时刻（jiffies）
+  void (*fn)(struct timer *); // 到期回调，在关中断、不持有时间轮锁的状态下调用
+  void *arg;                  // 回调参数
+  struct timer_base *base;    // 所在时间轮，未挂入时为0
+};
+
+/**
+ * 当前时刻（jiffies），由 time CSR 换算，每秒 HZ 个
+ */
+uint64 jiffies(void);
+
+/**
+ * 初始化定时器，不挂入时间轮
+ */
+void timer_init(struct timer *t, void (*fn)(struct timer *), void *arg);
+
+/**
+ * 将定时器加入当前 hart 的时间轮，已挂入的定时器先被取消，O(1)
+ * @param expires 到期时刻（jiffies），已过去的时刻会在下一次处理时立即到期
+ * @note 回调在添加定时器的 hart 上运行；回调中可以重新添加自己实现周期定时
+ */
+void timer_add(struct timer *t, uint64 expires);
+
+/**
+ * 取消定时器，O(1)
+ * @return 定时器原先挂在时间轮中返回1，已到期或未添加返回0
+ */
+int timer_cancel(struct timer *t);
+
+/**
+ * 处理当前 hart 时间轮中已到期的定时器，并重新设置硬件定时器
+ * @note 由定时器中断调用；关中断等待的代码在 wfi 返回后也应调用
+ */
+void timer_run(void);
+
+/**
+ * 初始化当前 hart 的时间轮并开启定时器中断
+ */
+void timerinithart(void);
+
+#endif // TIMER_H
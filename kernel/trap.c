@@ -0,0 +1,101 @@
+// 陷入处理
+// kernelvec.S 保存寄存器后调用 kerneltrap，按 scause 分发
+#include "types.h"
+#include "riscv.h"
+#include "memlayout.h"
+#include "vm.h"
+#include "trap.h"
+#include "printf.h"
+#include "plic.h"
+#include "uart.h"
+#include "sleep.h"
+
+extern char kernelvec[];
+
+struct fault_stats fault_stats;
+
+void trapinithart(void) {
+  w_stvec((uint64)kernelvec);
+}
+
+// 缺页处理：先查当前载入的页表，再交给 vm.c 按需分配或写时复制
+// 返回 0 已处理，-1 非法访问
+static int page_fault(uint64 scause, uint64 va) {
+  uint64 t0 = r_time();
+  pagetable_t pt = SATP2PT(r_satp());
+
+  int access = scause == SCAUSE_STORE_PAGE_FAULT ? PTE_W :
+               scause == SCAUSE_INST_PAGE_FAULT ? PTE_X : PTE_R;
+  int ret = uvmfault(pt, va, access);
+  if (ret < 0)
+    return -1;
+
+  uint64 dt = r_time() - t0;
+  if (ret == FAULT_COW)
+    __sync_fetch_and_add(&fault_stats.cow, 1);
+  else if (ret == FAULT_LAZY)
+    __sync_fetch_and_add(&fault_stats.lazy, 1);
+  else
+    __sync_fetch_and_add(&fault_stats.spurious, 1);
+  __sync_fetch_and_add(&fault_stats.ticks, dt);
+  uint64 max = fault_stats.max_ticks;
+  while (dt > max && !__sync_bool_compare_and_swap(&fault_stats.max_ticks, max, dt))
+    max = fault_stats.max_ticks;
+  return 0;
+}
+
+// 设备中断：从 PLIC 领取中断号并交给对应驱动
+static void devintr(void) {
+  int irq = plic_claim();
+  if (irq == UART0_IRQ)
+    uart_intr();
+  if (irq)
+    plic_complete(irq);
+}
+
+// 内核陷入分发，由 kernelvec 调用
+void kerneltrap(void) {
+  uint64 sepc = r_sepc();
+  uint64 sstatus = r_sstatus();
+  uint64 scause = r_scause();
+  uint64 stval = r_stval();
+
+  if (!(sstatus & SSTATUS_SPP))
+    panic("kerneltrap: not from supervisor mode");
+  if (intr_get())
+    panic("kerneltrap: interrupts enabled");
+
+  int handled = 0;
+  switch (scause) {
+  case SCAUSE_INST_PAGE_FAULT:
+  case SCAUSE_LOAD_PAGE_FAULT:
+  case SCAUSE_STORE_PAGE_FAULT:
+    handled = page_fault(scause, stval) == 0;
+    break;
+  case SCAUSE_SEXT:
+    devintr();
+    handled = 1;
+    break;
+  case SCAUSE_STIMER:
+    timer_intr();
+    handled = 1;
+    break;
+  }
+  if (!handled) {
+    printf("kerneltrap: scause=%p sepc=%p stval=%p\n", scause, sepc, stval);
+    panic("kerneltrap");
+  }
+
+  // 处理过程中可能发生嵌套陷入，恢复 sepc / sstatus 后再 sret
+  w_sepc(sepc);
+  w_sstatus(sstatus);
+}
+
+void fault_stats_dump(void) {
+  uint64 n = fault_stats.lazy + fault_stats.cow + fault_stats.spurious;
+  uint64 avg_ns = n ? fault_stats.ticks * (1000000000L / TIMEBASE_FREQ) / n : 0;
+  uint64 max_ns = fault_stats.max_ticks * (1000000000L / TIMEBASE_FREQ);
+  printf("page faults: lazy=%d cow=%d spurious=%d avg=%d ns max=%d ns\n",
+         (int)fault_stats.lazy, (int)fault_stats.cow, (int)fault_stats.spurious,
+         (int)avg_ns, (int)max_ns);
+}
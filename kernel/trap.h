@@ -0,0 +1,29 @@
+#ifndef TRAP_H
+#define TRAP_H
+
+// 陷入处理头文件
+// 目前只有 S 模式内核陷入：缺页异常交给 vm.c 处理（按需分配 / 写时复制）
+
+#include "types.h"
+
+// 缺页统计
+struct fault_stats {
+  uint64 lazy;         // 按需分配的缺页次数
+  uint64 cow;          // 写时复制的缺页次数
+  uint64 spurious;     // TLB 过时引起的缺页次数
+  uint64 ticks;        // 缺页处理累计耗时（time 计数）
+  uint64 max_ticks;    // 单次缺页处理的最长耗时
+};
+extern struct fault_stats fault_stats;
+
+/**
+ * 设置本 hart 的陷入向量，每个 hart 开启分页后调用一次
+ */
+void trapinithart(void);
+
+/**
+ * 打印缺页统计：次数、平均与最长处理时间
+ */
+void fault_stats_dump(void);
+
+#endif // TRAP_H
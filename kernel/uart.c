@@ -1,6 +1,7 @@
 // kernel/uart.c
 #include "types.h"
 #include "uart.h"
+#include "console.h"
 
 #define UART_BASE 0x10000000 // QEMU virt机器的串口地址
 
@@ -8,10 +9,20 @@
 enum {
     UART_THR = 0,  // 发送保持寄存器
     UART_RBR = 0,  // 接收缓冲寄存器  
+    UART_IER = 1,  // 中断使能寄存器
+    UART_FCR = 2,  // FIFO 控制寄存器（写）
+    UART_IIR = 2,  // 中断标识寄存器（读）
     UART_LCR = 3,  // 线控制寄存器
     UART_LSR = 5   // 线状态寄存器
 };
 
+#define IER_THRI   0x02  // 发送保持寄存器空中断
+#define FCR_ENABLE 0x07  // 开启并清空收发 FIFO
+#define LSR_THRE   0x20  // 发送 FIFO 为空
+
+#define UART_REG(r) ((volatile uint8_t *)(UART_BASE + (r)))
+
+// 同步输出一个字符：忙等发送保持寄存器空，用于 panic 等不能依赖中断的场合
 void uart_putc(char c) {
     volatile uint8_t *uart = (volatile uint8_t *)UART_BASE;
     volatile uint8_t *lsr = uart + 5;  // LSR 寄存器偏移
@@ -29,11 +40,36 @@ void uart_puts(char *s) {
     }
 }
 
-// 可选：初始化UART（最小实现可不调用）
+// 初始化UART
 void uart_init() {
     volatile uint8_t *uart = (volatile uint8_t *)UART_BASE;
     volatile uint8_t *lcr = uart + 3;  // LCR 寄存器偏移
 
     // 配置 8N1 (8位数据/无校验/1停止位)
     *lcr = 0x03;
+    // 开启 FIFO，一次发送空中断可以写入 UART_FIFO_SIZE 个字符
+    *UART_REG(UART_FCR) = FCR_ENABLE;
+    // 发送空中断由 console 按需开启
+    *UART_REG(UART_IER) = 0;
+}
+
+// 发送 FIFO 是否为空
+int uart_tx_ready(void) {
+    return (*UART_REG(UART_LSR) & LSR_THRE) != 0;
+}
+
+// 不等待地写入一个字符，调用者须确认 FIFO 仍有空间
+void uart_tx(char c) {
+    *UART_REG(UART_THR) = c;
+}
+
+// 开启或关闭发送空中断
+void uart_tx_intr(int enable) {
+    *UART_REG(UART_IER) = enable ? IER_THRI : 0;
+}
+
+// UART 中断处理：读取 IIR 应答中断，然后继续发送缓冲区中的字符
+void uart_intr(void) {
+    (void)*UART_REG(UART_IIR);
+    console_tx_intr();
 }
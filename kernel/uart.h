@@ -5,6 +5,13 @@ void uart_putc(char c);
 void uart_puts(char *s);
 void uart_init();
 
+#define UART_FIFO_SIZE 16  // 16550 发送 FIFO 深度
+
+int uart_tx_ready(void);
+void uart_tx(char c);
+void uart_tx_intr(int enable);
+void uart_intr(void);
+
 int puts(const char *s);
 int putchar(int c);
 
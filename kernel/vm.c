@@ -9,73 +9,154 @@
 #include "string.h"
 #include "memlayout.h"
 #include "riscv.h"
+#include "param.h"
+#include "cpu.h"
+#include "sbi.h"
+#include "asid.h"
+#include "spinlock.h"
+#include "hist.h"
+#include "pageops.h"
 
 // 内核页表全局变量
 pagetable_t kernel_pagetable = 0;
 
+struct tlb_stats tlb_stats;
+
+// 按需分配区间：已保留但尚未分配物理页的虚拟地址区间，首次访问时由缺页处理分配清零页
+#define NLAZY 16
+struct lazy_region {
+    pagetable_t pagetable;  // 0 表示空闲槽位
+    uint64 start;
+    uint64 end;
+    int perm;
+};
+static struct spinlock lazy_lock;
+static struct lazy_region lazy_regions[NLAZY];
+
+// 用户页表锁：修改用户页表（建立/解除映射、改权限、写时复制）和读写可移动页的反向映射都在锁内进行。
+// 缺页处理的查找与建立映射在锁内完成，多个 hart 同时缺页时只有一个建立映射，
+// 中间页表页的分配也不会互相覆盖；页迁移（规整、连续内存区回收）同样持有它，
+// 迁移中的页不会同时被解除映射或释放。锁序在 kmem.lock 与 cma.lock 之前；
+// 锁内只分配单页，高阶块（可能触发规整）在锁外分配
+struct spinlock pt_lock;
+
 // 内存区域映射辅助函数
-static void map_region(pagetable_t pt, uint64_t va, uint64_t pa, uint64_t size, int perm) {
-    for (uint64_t a = 0; a < size; a += PGSIZE) {
-        mappages(pt, va + a, PGSIZE, pa + a, perm);
-    }
+// 对齐允许时使用不超过 pgsz 的大页，减少页表页和 TLB 项
+static void map_region(pagetable_t pt, uint64_t va, uint64_t pa, uint64_t size, int perm, uint64_t pgsz) {
+    if (mappages_sz(pt, va, size, pa, perm, pgsz) != 0)
+        panic("map_region");
 }
 
 extern char etext[];
 
-void kvminit(void) {
+// 创建内核页表，pgsz 为允许使用的最大叶子大小
+pagetable_t kvmmake(uint64_t pgsz) {
     // 1. 创建内核页表
-    kernel_pagetable = uvmcreate();
+    pagetable_t pt = uvmcreate();
+    if (pt == NULL)
+        panic("kvmmake");
     
     // 2. 映射内核代码段（R+X）
-    map_region(kernel_pagetable, KERNBASE, KERNBASE, (uint64_t)etext - KERNBASE, PTE_R | PTE_X);
+    map_region(pt, KERNBASE, KERNBASE, (uint64_t)etext - KERNBASE, PTE_R | PTE_X, pgsz);
     
     // 3. 映射内核数据段（R+W）
-    map_region(kernel_pagetable, (uint64_t)etext, (uint64_t)etext, PHYSTOP - (uint64_t)etext, PTE_R | PTE_W);
+    map_region(pt, (uint64_t)etext, (uint64_t)etext, PHYSTOP - (uint64_t)etext, PTE_R | PTE_W, pgsz);
     
     // 4. 映射 UART 设备 (R+W)
-    map_region(kernel_pagetable, UART0, UART0, PGSIZE, PTE_R | PTE_W);
+    map_region(pt, UART0, UART0, PGSIZE, PTE_R | PTE_W, pgsz);
 
     // --- 新增：映射 CLINT (用于 sleep / timer) ---
     // CLINT 通常占用 0x10000 (64KB)
-    map_region(kernel_pagetable, CLINT, CLINT, 0x10000, PTE_R | PTE_W);
+    map_region(pt, CLINT, CLINT, 0x10000, PTE_R | PTE_W, pgsz);
 
     // --- 新增：映射 PLIC (用于中断控制器，虽然现在可能还没用，但以后必用) ---
     // PLIC 通常占用 0x400000 (4MB)
-    map_region(kernel_pagetable, PLIC, PLIC, 0x400000, PTE_R | PTE_W);
+    map_region(pt, PLIC, PLIC, 0x400000, PTE_R | PTE_W, pgsz);
+
+    return pt;
+}
+
+void kvminit(void) {
+    initlock(&lazy_lock, "lazy");
+    initlock(&pt_lock, "pagetable");
+    kernel_pagetable = kvmmake(GIGAPGSIZE);
+    // 内核映射在所有地址空间中都相同，标记为全局，切换 ASID 时不受影响
+    for (int i = 0; i < 512; i++) {
+        if (kernel_pagetable[i] & PTE_V)
+            kernel_pagetable[i] |= PTE_G;
+    }
 }
 
 void kvminithart(void) {
-    // 激活内核页表
-    uint64_t satp = (8L << 60) | (((uint64_t)kernel_pagetable >> 12) & 0xFFFFFFFFFFF);
-    w_satp(satp);
+    // 激活内核页表，内核固定使用 ASID 0
+    w_satp(MAKE_SATP(kernel_pagetable));
     sfence_vma();
+    mycpu()->asid_ctx = 0;
+}
+
+// 把内核映射共享进用户页表：直接复制内核根页表中的全局表项，下级页表不复制
+void kvmshare(pagetable_t pagetable)
+{
+    for (int i = 0; i < 512; i++) {
+        if ((kernel_pagetable[i] & PTE_V) && !(pagetable[i] & PTE_V))
+            pagetable[i] = kernel_pagetable[i];
+    }
+}
+
+// 切换到用户页表：带 ASID 写 satp，不整体刷新 TLB
+// 页表必须已通过 kvmshare 包含内核映射
+void uvmswitch(pagetable_t pagetable)
+{
+    push_off();
+    uint64 asid = asid_acquire(pagetable);
+    w_satp(MAKE_SATP_ASID(pagetable, asid));
+    if (asid_bits == 0)
+        sfence_vma(); // 硬件不支持 ASID，只能整体刷新
+    pop_off();
+}
+
+// 切换回内核页表
+void kvmswitch(void)
+{
+    push_off();
+    w_satp(MAKE_SATP(kernel_pagetable));
+    if (asid_bits == 0)
+        sfence_vma();
+    mycpu()->asid_ctx = 0;
+    pop_off();
 }
 
 // 递归销毁页表，释放所有页表页（不释放映射的物理页）
+// 任意级别的叶子（包括 2MB / 1GB 大页）都不再向下递归，
+// 全局的中间表项是通过 kvmshare 共享的内核页表，同样跳过
 void destroy_pagetable(pagetable_t pt)
 {
     for (int i = 0; i < 512; i++) {
         pte_t pte = pt[i];
-        if ((pte & PTE_V) && (pte & (PTE_R|PTE_W|PTE_X)) == 0) {
+        if ((pte & PTE_V) && !PTE_LEAF(pte) && !(pte & PTE_G)) {
             // 有效且为中间页表
             pagetable_t child = (pagetable_t)PTE2PA(pte);
             destroy_pagetable(child);
         }
     }
+    asid_release(pt);
+    uvmlazy_release(pt);
     kfree(pt);
 }
 
 // 打印页表内容，递归打印每级页表
+// level 为递归深度：0 为顶级页表，深度 0/1/2 上的叶子分别映射 1GB/2MB/4KB
 void dump_pagetable(pagetable_t pt, int level)
 {
+    static const char *leaf_size[] = { "1G", "2M", "4K" };
     for (int i = 0; i < 512; i++) {
         pte_t pte = pt[i];
         if (pte & PTE_V) {
             for (int l = 0; l < level; l++)
                 printf("  ");
             printf("[%d] pte=0x%lx", i, pte);
-            if (pte & (PTE_R|PTE_W|PTE_X)) {
-                printf(" -> leaf, pa=0x%lx\n", PTE2PA(pte));
+            if (PTE_LEAF(pte)) {
+                printf(" -> leaf %s, pa=0x%lx\n", leaf_size[level], PTE2PA(pte));
             } else {
                 printf(" -> next level\n");
                 dump_pagetable((pagetable_t)PTE2PA(pte), level+1);
@@ -85,68 +166,690 @@ void dump_pagetable(pagetable_t pt, int level)
 }
 
 
-// 遍历多级页表，返回虚拟地址 va 在页表中的页表项指针
+// 遍历多级页表，返回虚拟地址 va 在第 level 级页表中的页表项指针
 // alloc=1 时，若中间页表不存在则自动分配
+// 若途中遇到大页叶子：alloc=0 时返回该叶子 PTE，alloc=1 时视为冲突返回 NULL
 // 返回值：指向页表项的指针，失败返回 NULL
-pte_t *walk(pagetable_t pagetable, uint64_t va, int alloc)
+pte_t *walk_level(pagetable_t pagetable, uint64_t va, int alloc, int level)
 {
     // Sv39 虚拟地址最大 39 位
     if (va >= (1L << 39))
         return NULL;
-    // 从顶级（2）到次级（1）依次查找
-    for (int level = 2; level > 0; level--) {
+    // 从顶级（2）向下依次查找，直到目标级别
+    for (int l = 2; l > level; l--) {
         // 取当前层的页表项指针
-        pte_t *pte = &pagetable[PX(level, va)];
+        pte_t *pte = &pagetable[PX(l, va)];
         if (*pte & PTE_V) {
+            if (PTE_LEAF(*pte))
+                return alloc ? NULL : pte; // 大页叶子
             // 有效则跳转到下一层页表
             pagetable = (pagetable_t)PTE2PA(*pte);
         } else {
-            // 无效且需要分配新页表
+            // 无效且需要分配新页表（kalloc 返回的页已清零）
             if (!alloc || (pagetable = (pagetable_t)kalloc()) == NULL)
                 return NULL;
-            memset(pagetable, 0, PGSIZE); // 新页表清零
             *pte = PA2PTE((uint64_t)pagetable) | PTE_V; // 建立映射
         }
     }
-    // 返回第0级页表项指针
-    return &pagetable[PX(0, va)];
+    return &pagetable[PX(level, va)];
+}
+
+// 返回 va 对应的第0级页表项指针（或覆盖 va 的大页叶子，见 walk_level）
+pte_t *walk(pagetable_t pagetable, uint64_t va, int alloc)
+{
+    HIST_BEGIN();
+    pte_t *pte = walk_level(pagetable, va, alloc, 0);
+    HIST_END(HIST_WALK);
+    return pte;
 }
 
 
 // 在页表 pagetable 中建立从 va 到 pa 的映射，大小 size，权限 perm
+// pgsz 为允许使用的最大叶子大小（PGSIZE / MEGAPGSIZE / GIGAPGSIZE），
+// va 与 pa 同时按大页对齐且剩余长度足够时使用大页，不对齐的边缘退回 4KB
+// 每次从根下降到目标页表后，连续填写该页表中的叶子槽位，
+// 只有跨越上一级边界（如 4KB 叶子跨越 2MB 边界）时才重新从根查找
 // va/pa/size 必须页对齐
-// perm: 权限位（如PTE_R|PTE_W等）
 // 返回 0 成功，-1 失败
-int mappages(pagetable_t pagetable, uint64_t va, uint64_t size, uint64_t pa, int perm)
+static int map_range(pagetable_t pagetable, uint64_t va, uint64_t size, uint64_t pa, int perm, uint64_t pgsz)
 {
-    uint64_t a, last;
+    uint64_t a, end;
     pte_t *pte;
+    if (size == 0)
+        return -1;
     a = PGROUNDDOWN(va); // 起始虚拟地址页对齐
-    last = PGROUNDDOWN(va + size - 1); // 结束虚拟地址页对齐
-    for (;;) {
-        pte = walk(pagetable, a, 1); // 查找/分配页表项
+    end = PGROUNDDOWN(va + size - 1) + PGSIZE; // 结束虚拟地址（不含）
+    while (a < end) {
+        // 选择当前位置允许的最大叶子级别
+        int level = 2;
+        for (; level > 0; level--) {
+            uint64_t sz = PXSIZE(level);
+            if (sz <= pgsz && (a % sz) == 0 && (pa % sz) == 0 && end - a >= sz)
+                break;
+        }
+        pte = walk_level(pagetable, a, 1, level); // 查找/分配页表项
         if (pte == NULL)
             return -1;
-        if (*pte & PTE_V)
-            return -1; // 已经映射，报错
-        *pte = PA2PTE(pa) | perm | PTE_V; // 建立映射
-        if (a == last)
-            break;
-        a += PGSIZE;
-        pa += PGSIZE;
+
+        // 在同一张页表内连续填写叶子，直到越过页表末尾或剩余不足一个叶子
+        uint64_t sz = PXSIZE(level);
+        do {
+            if (*pte & PTE_V)
+                return -1; // 已经映射，报错
+            *pte = PA2PTE(pa) | perm | PTE_V; // 建立映射
+            pte++;
+            a += sz;
+            pa += sz;
+        } while (a < end && end - a >= sz && PX(level, a) != 0);
     }
     return 0;
 }
 
+int mappages_sz(pagetable_t pagetable, uint64_t va, uint64_t size, uint64_t pa, int perm, uint64_t pgsz)
+{
+    HIST_BEGIN();
+    int ret = map_range(pagetable, va, size, pa, perm, pgsz);
+    HIST_END(HIST_MAPPAGES);
+    return ret;
+}
+
+// 在页表 pagetable 中建立从 va 到 pa 的映射，只使用 4KB 叶子
+// perm: 权限位（如PTE_R|PTE_W等）
+// 返回 0 成功，-1 失败
+int mappages(pagetable_t pagetable, uint64_t va, uint64_t size, uint64_t pa, int perm)
+{
+    return mappages_sz(pagetable, va, size, pa, perm, PGSIZE);
+}
+
 
 // 创建一个空的用户页表（顶级页表）
 // 返回新分配的页表指针，失败返回 NULL
 pagetable_t uvmcreate(void)
 {
     pagetable_t pagetable;
-    pagetable = (pagetable_t)kalloc(); // 分配一页作为顶级页表
+    pagetable = (pagetable_t)kalloc(); // 分配一页作为顶级页表（已清零）
     if (pagetable == NULL)
         return NULL;
-    memset(pagetable, 0, PGSIZE); // 清零
     return pagetable;
-}
\ No newline at end of file
+}
+
+
+// 不分配地查找 va：返回下降停止处的页表项指针，并通过 level 返回其级别。
+// 停止处要么是有效叶子（可能是大页），要么是无效项（此时整个 PXSIZE(level) 区间都未映射）
+static pte_t *lookup(pagetable_t pagetable, uint64 va, int *level)
+{
+    if (va >= (1L << 39))
+        return NULL;
+    for (int l = 2; l > 0; l--) {
+        pte_t *pte = &pagetable[PX(l, va)];
+        if (!(*pte & PTE_V) || PTE_LEAF(*pte)) {
+            *level = l;
+            return pte;
+        }
+        pagetable = (pagetable_t)PTE2PA(*pte);
+    }
+    *level = 0;
+    return &pagetable[PX(0, va)];
+}
+
+// 虚拟地址转换：返回 va 对应的物理地址（含页内偏移），未映射返回 0
+uint64 walkaddr(pagetable_t pagetable, uint64 va)
+{
+    int level;
+    pte_t *pte = lookup(pagetable, va, &level);
+    if (pte == NULL || !(*pte & PTE_V))
+        return 0;
+    return PTE2PA(*pte) + (va & (PXSIZE(level) - 1));
+}
+
+// 对 [va, va+size) 中的每个有效叶子调用 op，并把被修改的页加入 tb。
+// 第0级页表内的槽位连续处理，空洞按其所在级别整块跳过。
+// 大页叶子必须被完整覆盖，否则返回 -1
+static int range_apply(pagetable_t pagetable, uint64 va, uint64 size,
+                       void (*op)(pte_t *pte, uint64 arg, struct tlb_batch *tb), uint64 arg,
+                       struct tlb_batch *tb)
+{
+    uint64 a = PGROUNDDOWN(va);
+    uint64 end = PGROUNDUP(va + size);
+    while (a < end) {
+        int level;
+        pte_t *pte = lookup(pagetable, a, &level);
+        if (pte == NULL)
+            return -1;
+        uint64 sz = PXSIZE(level);
+        if (level > 0) {
+            if (*pte & PTE_V) {
+                if ((a % sz) != 0 || end - a < sz)
+                    return -1; // 不支持拆分大页
+                op(pte, arg, tb);
+                tlb_batch_add(tb, a);
+            }
+            a = (a & ~(sz - 1)) + sz;
+            continue;
+        }
+        do {
+            if (*pte & PTE_V) {
+                op(pte, arg, tb);
+                tlb_batch_add(tb, a);
+            }
+            pte++;
+            a += PGSIZE;
+        } while (a < end && PX(0, a) != 0);
+    }
+    return 0;
+}
+
+// 可移动页的页私有字记录映射它的唯一 PTE（反向映射），供 uvm_migrate 找到并改写映射
+// 写时复制共享的页只记录其中一个 PTE；这一方复制走或解除映射后反向映射被清零，
+// 剩下的一方在自己写入（uvmcow_fault 重新记录）之前无法迁移，CMA 与规整都会跳过这样的页
+static void rmap_set(void *pa, pte_t *pte)
+{
+    kpage_set_private(pa, (uint64)pte);
+}
+
+// pte 不再映射其物理页时调用，只清除指向 pte 本身的反向映射
+static void rmap_clear(pte_t *pte)
+{
+    void *pa = (void *)PTE2PA(*pte);
+    if (kpage_private(pa) == (uint64)pte)
+        kpage_set_private(pa, 0);
+}
+
+// 物理页在 TLB 刷新之后才释放，见 tlb_batch_free
+static void unmap_op(pte_t *pte, uint64 do_free, struct tlb_batch *tb)
+{
+    rmap_clear(pte);
+    if (do_free)
+        tlb_batch_free(tb, (void *)PTE2PA(*pte));
+    *pte = 0;
+}
+
+static void protect_op(pte_t *pte, uint64 perm, struct tlb_batch *tb)
+{
+    (void)tb;
+    *pte = (*pte & ~(pte_t)(PTE_R | PTE_W | PTE_X | PTE_U)) | perm;
+}
+
+// 解除 [va, va+npages*PGSIZE) 的映射，do_free 时同时释放物理页；未映射的页直接跳过。
+// 被修改的页加入 tb，由调用者决定何时刷新 TLB；要释放的物理页在刷新之后才释放
+void uvmunmap_batch(pagetable_t pagetable, uint64 va, uint64 npages, int do_free, struct tlb_batch *tb)
+{
+    if ((va % PGSIZE) != 0)
+        panic("uvmunmap: not aligned");
+    acquire(&pt_lock);
+    int ret = range_apply(pagetable, va, npages * PGSIZE, unmap_op, do_free, tb);
+    release(&pt_lock);
+    if (ret != 0)
+        panic("uvmunmap: partial superpage");
+}
+
+// 解除映射并立即刷新 TLB
+void uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
+{
+    struct tlb_batch tb;
+    tlb_batch_init(&tb, pagetable);
+    uvmunmap_batch(pagetable, va, npages, do_free, &tb);
+    tlb_batch_flush(&tb);
+}
+
+// 修改 [va, va+size) 中已映射页的权限为 perm（R/W/X/U 的组合）
+// 返回 0 成功，-1 失败（权限非法或只覆盖了大页的一部分）
+int uvmprotect(pagetable_t pagetable, uint64 va, uint64 size, int perm)
+{
+    // 至少要有 R 或 X，否则 PTE 会变成指向下一级页表；W 必须伴随 R
+    if (!(perm & (PTE_R | PTE_X)) || ((perm & PTE_W) && !(perm & PTE_R)))
+        return -1;
+    if (perm & ~(PTE_R | PTE_W | PTE_X | PTE_U))
+        return -1;
+
+    struct tlb_batch tb;
+    tlb_batch_init(&tb, pagetable);
+    acquire(&pt_lock);
+    int ret = range_apply(pagetable, va, size, protect_op, perm, &tb);
+    release(&pt_lock);
+    tlb_batch_flush(&tb);
+    return ret;
+}
+
+// 为 [oldsz, newsz) 分配并映射已清零的可移动物理页，返回新大小，失败返回 0
+uint64 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int perm)
+{
+    if (newsz < oldsz)
+        return oldsz;
+
+    for (uint64 a = PGROUNDUP(oldsz); a < newsz; a += PGSIZE) {
+        void *mem = kalloc_movable();
+        if (mem == NULL) {
+            uvmdealloc(pagetable, a, oldsz);
+            return 0;
+        }
+        acquire(&pt_lock);
+        int ret = mappages(pagetable, a, PGSIZE, (uint64)mem, perm);
+        if (ret == 0)
+            rmap_set(mem, walk(pagetable, a, 0));
+        release(&pt_lock);
+        if (ret != 0) {
+            kfree(mem);
+            uvmdealloc(pagetable, a, oldsz);
+            return 0;
+        }
+    }
+    return newsz;
+}
+
+// 将大小从 oldsz 缩小到 newsz，释放多余的页，返回新大小
+uint64 uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
+{
+    if (newsz >= oldsz)
+        return oldsz;
+
+    if (PGROUNDUP(newsz) < PGROUNDUP(oldsz)) {
+        uint64 npages = (PGROUNDUP(oldsz) - PGROUNDUP(newsz)) / PGSIZE;
+        uvmunmap(pagetable, PGROUNDUP(newsz), npages, 1);
+    }
+    return newsz;
+}
+
+void tlb_batch_init(struct tlb_batch *tb, pagetable_t pagetable)
+{
+    tb->pagetable = pagetable;
+    tb->nranges = 0;
+    tb->npages = 0;
+    tb->overflow = 0;
+    tb->nfree = 0;
+}
+
+// 记录一个需要刷新的虚拟页，与上一个区间相邻时直接合并
+void tlb_batch_add(struct tlb_batch *tb, uint64 va)
+{
+    va = PGROUNDDOWN(va);
+    tb->npages++;
+    if (tb->nranges > 0 && tb->end[tb->nranges - 1] == va) {
+        tb->end[tb->nranges - 1] += PGSIZE;
+    } else if (tb->nranges < TLB_BATCH_RANGES) {
+        tb->start[tb->nranges] = va;
+        tb->end[tb->nranges] = va + PGSIZE;
+        tb->nranges++;
+    } else {
+        tb->overflow = 1;
+    }
+}
+
+// 记录一个刷新 TLB 之后才能释放的物理页；暂存已满时先刷新并释放已暂存的页
+void tlb_batch_free(struct tlb_batch *tb, void *pa)
+{
+    if (tb->nfree == TLB_BATCH_FREE)
+        tlb_batch_flush(tb);
+    tb->free[tb->nfree++] = pa;
+}
+
+// 刷新完成后释放暂存的物理页并清空批处理
+static void tlb_batch_done(struct tlb_batch *tb)
+{
+    for (int i = 0; i < tb->nfree; i++)
+        kfree(tb->free[i]);
+    tlb_batch_init(tb, tb->pagetable);
+}
+
+// 除本 hart 外已上线 hart 的位图
+static uint64 other_harts_mask(void)
+{
+    uint64 mask = 0;
+    int self = cpuid();
+    for (int i = 0; i < NCPU; i++) {
+        if (i != self && cpus[i].started)
+            mask |= 1UL << i;
+    }
+    return mask;
+}
+
+// 按收集到的区间刷新 TLB，再释放暂存的物理页并清空批处理
+// 内核页表的映射是全局的，按地址刷新所有 ASID 并通过 SBI 通知其他 hart；
+// 用户页表只刷新自己 ASID 的项，从未载入过的页表不可能有 TLB 项，无需刷新
+void tlb_batch_flush(struct tlb_batch *tb)
+{
+    int kernel = tb->pagetable == kernel_pagetable;
+    uint64 asid = kernel ? 0 : asid_of(tb->pagetable);
+    if (tb->npages == 0 || asid == ASID_NONE) {
+        tlb_batch_done(tb);
+        return;
+    }
+
+    int global = tb->overflow || tb->npages > TLB_FLUSH_THRESHOLD;
+    if (global) {
+        if (kernel)
+            sfence_vma();
+        else
+            sfence_vma_asid(asid);
+        __sync_fetch_and_add(&tlb_stats.global_flushes, 1);
+    } else {
+        for (int i = 0; i < tb->nranges; i++) {
+            for (uint64 va = tb->start[i]; va < tb->end[i]; va += PGSIZE) {
+                if (kernel)
+                    sfence_vma_va(va);
+                else
+                    sfence_vma_va_asid(va, asid);
+            }
+        }
+        __sync_fetch_and_add(&tlb_stats.page_flushes, tb->npages);
+    }
+
+    // 用户页表可能在其他 hart 上运行过，同样需要通知它们按 ASID 刷新
+    uint64 mask = other_harts_mask();
+    if (mask != 0) {
+        if (global) {
+            if (kernel)
+                sbi_remote_sfence_vma(mask, 0, 0, (uint64)-1);
+            else
+                sbi_remote_sfence_vma_asid(mask, 0, 0, (uint64)-1, asid);
+        } else {
+            for (int i = 0; i < tb->nranges; i++) {
+                uint64 len = tb->end[i] - tb->start[i];
+                if (kernel)
+                    sbi_remote_sfence_vma(mask, 0, tb->start[i], len);
+                else
+                    sbi_remote_sfence_vma_asid(mask, 0, tb->start[i], len, asid);
+            }
+        }
+        __sync_fetch_and_add(&tlb_stats.remote_flushes, 1);
+    }
+
+    tlb_batch_done(tb);
+}
+
+// 释放页表中所有用户叶子映射的物理页（共享的页只减少引用），调用者须持有 pt_lock
+// 全局表项属于共享的内核页表，跳过
+static void free_leaves(pagetable_t pt)
+{
+    for (int i = 0; i < 512; i++) {
+        pte_t pte = pt[i];
+        if (!(pte & PTE_V) || (pte & PTE_G))
+            continue;
+        if (PTE_LEAF(pte)) {
+            rmap_clear(&pt[i]);
+            kfree((void *)PTE2PA(pte));
+        } else
+            free_leaves((pagetable_t)PTE2PA(pte));
+    }
+}
+
+// 释放所有用户页，再销毁页表本身
+void uvmfree(pagetable_t pagetable)
+{
+    acquire(&pt_lock);
+    free_leaves(pagetable);
+    release(&pt_lock);
+    destroy_pagetable(pagetable);
+}
+
+// 逐级复制页表结构，叶子页只共享不复制：可写页在新旧页表中都改为只读并标记 PTE_COW
+// level 为 old 所在级别，va 为 old 覆盖区间的起始虚拟地址
+static int cow_dup(pagetable_t old, pagetable_t new, int level, uint64 va, struct tlb_batch *tb)
+{
+    for (int i = 0; i < 512; i++) {
+        pte_t pte = old[i];
+        if (!(pte & PTE_V) || (pte & PTE_G))
+            continue;
+        if (new[i] & PTE_V)
+            return -1; // 目标页表中已有映射
+        uint64 a = va + ((uint64)i << PXSHIFT(level));
+
+        if (!PTE_LEAF(pte)) {
+            pagetable_t child = (pagetable_t)kalloc();
+            if (child == NULL)
+                return -1;
+            new[i] = PA2PTE(child) | PTE_V;
+            if (cow_dup((pagetable_t)PTE2PA(pte), child, level - 1, a, tb) != 0)
+                return -1;
+            continue;
+        }
+
+        if (pte & PTE_W) {
+            if (level == 2)
+                return -1; // 1GB 大页无法在缺页时复制
+            pte = (pte & ~PTE_W) | PTE_COW;
+            old[i] = pte;
+            tlb_batch_add(tb, a);
+        }
+        kpage_ref((void *)PTE2PA(pte));
+        new[i] = pte;
+    }
+    return 0;
+}
+
+// 写时复制地复制 old 中的所有用户映射到 new（fork 式复制）
+// 只复制页表页，开销与页表大小成正比，与驻留内存无关
+// 返回 0 成功；-1 失败，此时 new 中已建立的映射仍各自持有引用，调用者应以 uvmfree 回收 new
+int uvmcopy_cow(pagetable_t old, pagetable_t new)
+{
+    struct tlb_batch tb;
+    tlb_batch_init(&tb, old);
+    acquire(&pt_lock);
+    int ret = cow_dup(old, new, 2, 0, &tb);
+    release(&pt_lock);
+    // old 中被改为只读的页可能还缓存在 TLB 中
+    tlb_batch_flush(&tb);
+    return ret;
+}
+
+// 写时复制缺页处理：va 处的写入命中 PTE_COW 页时调用
+// 页仍被共享则复制一份私有副本，已是唯一持有者则直接恢复可写
+// 副本在锁外分配和复制，换上副本前在锁内确认 PTE 没有变化：多个 hart 同时写同一页时，
+// 只有第一个换上副本并放弃共享页的引用，其余的丢弃各自的副本，不会多减其他持有者的引用
+// 返回 0 已处理，-1 不是写时复制页或内存不足（调用者按非法访问处理）
+int uvmcow_fault(pagetable_t pagetable, uint64 va)
+{
+    struct tlb_batch tb;
+    tlb_batch_init(&tb, pagetable);
+    int level;
+    acquire(&pt_lock);
+    pte_t *pte = lookup(pagetable, va, &level);
+    if (pte == NULL || !(*pte & PTE_V) || !(*pte & PTE_COW)) {
+        release(&pt_lock);
+        return -1;
+    }
+
+    pte_t old = *pte;
+    uint64 pa = PTE2PA(old);
+    uint64 flags = (PTE_FLAGS(old) & ~PTE_COW) | PTE_W;
+    if (kpage_refcount((void *)pa) == 1) {
+        // 已是唯一持有者，反向映射可能还指向已复制走的另一个 PTE
+        *pte = PA2PTE(pa) | flags;
+        if (level == 0)
+            rmap_set((void *)pa, pte);
+        release(&pt_lock);
+    } else {
+        release(&pt_lock);
+        uint64 size = PXSIZE(level);
+        void *mem = level == 0 ? kalloc_movable_nozero() : kalloc_pages(size / PGSIZE);
+        if (mem == NULL)
+            return -1;
+        page_copy(mem, (void *)pa, size / PGSIZE);
+
+        acquire(&pt_lock);
+        pte = lookup(pagetable, va, &level);
+        if (pte == NULL || (*pte & ~(PTE_A | PTE_D)) != (old & ~(PTE_A | PTE_D))) {
+            // 其他 hart 已经处理了这次写时复制，或者页已被解除映射；重新执行的访问会按新的 PTE 处理
+            release(&pt_lock);
+            kfree(mem);
+            return 0;
+        }
+        rmap_clear(pte);
+        *pte = PA2PTE(mem) | flags;
+        if (level == 0)
+            rmap_set(mem, pte);
+        release(&pt_lock);
+        tlb_batch_free(&tb, (void *)pa); // 刷新后放弃对共享页的引用
+    }
+
+    tlb_batch_add(&tb, va);
+    tlb_batch_flush(&tb);
+    return 0;
+}
+
+// 为 pagetable 保留 [va, va+size) 作为按需分配区间，不分配任何物理页
+// 返回 0 成功，-1 参数非法或区间表已满
+int uvmlazy(pagetable_t pagetable, uint64 va, uint64 size, int perm)
+{
+    if ((va % PGSIZE) != 0 || size == 0 || va + size > MAXVA || !(perm & (PTE_R | PTE_X)))
+        return -1;
+
+    acquire(&lazy_lock);
+    for (int i = 0; i < NLAZY; i++) {
+        struct lazy_region *r = &lazy_regions[i];
+        if (r->pagetable == 0) {
+            r->start = va;
+            r->end = PGROUNDUP(va + size);
+            r->perm = perm;
+            r->pagetable = pagetable;
+            release(&lazy_lock);
+            return 0;
+        }
+    }
+    release(&lazy_lock);
+    return -1;
+}
+
+// 删除 pagetable 的所有按需分配区间（已分配的页不受影响）
+void uvmlazy_release(pagetable_t pagetable)
+{
+    acquire(&lazy_lock);
+    for (int i = 0; i < NLAZY; i++) {
+        if (lazy_regions[i].pagetable == pagetable)
+            lazy_regions[i].pagetable = 0;
+    }
+    release(&lazy_lock);
+}
+
+// 查找 va 所在按需分配区间的权限，不在任何区间内返回0
+static int lazy_perm(pagetable_t pagetable, uint64 va)
+{
+    int perm = 0;
+    acquire(&lazy_lock);
+    for (int i = 0; i < NLAZY; i++) {
+        struct lazy_region *r = &lazy_regions[i];
+        if (r->pagetable == pagetable && va >= r->start && va < r->end) {
+            perm = r->perm;
+            break;
+        }
+    }
+    release(&lazy_lock);
+    return perm;
+}
+
+// 只刷新本 hart 上 pagetable 中 va 的 TLB 项
+static void flush_local(pagetable_t pagetable, uint64 va)
+{
+    uint64 asid = asid_of(pagetable);
+    if (pagetable == kernel_pagetable || asid == ASID_NONE)
+        sfence_vma_va(va);
+    else
+        sfence_vma_va_asid(va, asid);
+}
+
+// 缺页处理：access 为引发缺页的访问类型（PTE_R / PTE_W / PTE_X 之一）
+// 已映射的写时复制页交给 uvmcow_fault；未映射且位于按需分配区间内的页分配清零页并映射
+// 多个 hart 可能同时在同一页上缺页：页在锁外分配，映射前在锁内重新查找，
+// 已被其他 hart 映射时放弃自己分配的页，按已映射的情况重新处理
+// 返回 FAULT_* 表示已处理，-1 表示非法访问
+int uvmfault(pagetable_t pagetable, uint64 va, int access)
+{
+    if (va >= MAXVA)
+        return -1;
+
+    int level;
+    acquire(&pt_lock);
+    pte_t *pte = lookup(pagetable, va, &level);
+    pte_t cur = pte != NULL ? *pte : 0;
+    release(&pt_lock);
+    if (cur & PTE_V) {
+        if (access == PTE_W && (cur & PTE_COW))
+            return uvmcow_fault(pagetable, va) == 0 ? FAULT_COW : -1;
+        if (cur & access) {
+            // 页已由其他 hart 映射，本 hart 的 TLB 中还是旧的无效项
+            flush_local(pagetable, va);
+            return FAULT_SPURIOUS;
+        }
+        return -1; // 权限不符
+    }
+
+    int perm = lazy_perm(pagetable, va);
+    if (perm == 0)
+        return -1;
+    void *mem = kalloc_movable();
+    if (mem == NULL)
+        return -1;
+
+    acquire(&pt_lock);
+    pte = lookup(pagetable, va, &level);
+    if (pte != NULL && (*pte & PTE_V)) {
+        // 分配期间其他 hart 已映射了这一页
+        release(&pt_lock);
+        kfree(mem);
+        return uvmfault(pagetable, va, access);
+    }
+    if (mappages(pagetable, PGROUNDDOWN(va), PGSIZE, (uint64)mem, perm) != 0) {
+        release(&pt_lock);
+        kfree(mem);
+        return -1;
+    }
+    rmap_set(mem, walk(pagetable, PGROUNDDOWN(va), 0));
+    release(&pt_lock);
+    // 无效到有效的变化只需刷新本 hart：其他 hart 若缓存了无效项，会再次缺页并按 FAULT_SPURIOUS 处理
+    flush_local(pagetable, va);
+    return FAULT_LAZY;
+}
+
+// 整体刷新所有 hart 的 TLB
+static void flush_all_harts(void)
+{
+    sfence_vma();
+    uint64 mask = other_harts_mask();
+    if (mask)
+        sbi_remote_sfence_vma(mask, 0, 0, (uint64)-1);
+    __sync_fetch_and_add(&tlb_stats.global_flushes, 1);
+}
+
+// 把可移动页 old 的内容迁移到 new，并把映射它的 PTE 改为指向 new，权限不变
+// 返回 0 成功（old 不再被引用，由调用者回收），-1 无法迁移（没有有效的反向映射、页被共享，
+// 或 PTE 在复制期间被改变），此时 new 仍归调用者所有
+// 不知道页所属的地址空间，因此整体刷新所有 hart 的 TLB
+// 调用者须持有 pt_lock：反向映射与 PTE 在迁移期间不会被缺页处理、解除映射或释放改变
+int uvm_migrate(void *old, void *new)
+{
+    if (!holding(&pt_lock))
+        panic("uvm_migrate: pt_lock");
+    pte_t *pte = (pte_t *)kpage_private(old);
+    if (pte == NULL)
+        return -1;
+    pte_t cur = *pte;
+    if (!(cur & PTE_V) || !PTE_LEAF(cur) || PTE2PA(cur) != (uint64)old)
+        return -1;
+    if (kpage_refcount(old) != 1)
+        return -1;
+
+    // 1. 只撤销写权限并刷新 TLB：复制期间的读取照常命中旧页，
+    //    写入会缺页并在 pt_lock 上等待，迁移结束后按 FAULT_SPURIOUS 重新执行
+    pte_t ro = cur & ~(pte_t)PTE_W;
+    if (ro != cur && !__sync_bool_compare_and_swap(pte, cur, ro))
+        return -1;
+    flush_all_harts();
+
+    page_copy(new, old, 1);
+
+    // 2. 以比较并交换换上新页：复制期间硬件可能置位 A 位，除此之外 PTE 有任何变化都放弃迁移
+    for (;;) {
+        pte_t now = *pte;
+        if ((now & ~(pte_t)(PTE_A | PTE_D)) != (ro & ~(pte_t)(PTE_A | PTE_D)))
+            return -1;
+        pte_t moved = PA2PTE(new) | PTE_FLAGS(now) | (cur & PTE_W);
+        if (__sync_bool_compare_and_swap(pte, now, moved))
+            break;
+    }
+    rmap_set(new, pte);
+    kpage_set_private(old, 0);
+
+    // 3. 其他 hart 可能缓存了指向旧页的只读项，刷新后旧页才能交还调用者
+    flush_all_harts();
+    return 0;
+}
@@ -3,12 +3,71 @@
 
 #include"types.h"
 #include"memlayout.h"
+
+// TLB 失效批处理：修改页表时先收集被改动的虚拟页，最后统一刷新。
+// 需刷新的页数不超过 TLB_FLUSH_THRESHOLD 时逐页 sfence.vma，否则一次整体刷新
+// 解除映射后要释放的物理页也暂存在批处理中，刷新之后才释放，
+// 其他 hart 上残留的 TLB 项就不会指向已被重新分配的页；暂存满时提前刷新一次
+#define TLB_BATCH_RANGES    8
+#define TLB_FLUSH_THRESHOLD 32
+#define TLB_BATCH_FREE      64
+
+struct tlb_batch {
+  pagetable_t pagetable;            // 被修改的页表
+  uint64 start[TLB_BATCH_RANGES];   // 合并后的连续虚拟地址区间
+  uint64 end[TLB_BATCH_RANGES];
+  int nranges;
+  uint64 npages;                    // 需要刷新的页数
+  int overflow;                     // 区间数超限，只能整体刷新
+  void *free[TLB_BATCH_FREE];       // 刷新后再释放的物理页
+  int nfree;
+};
+
+// TLB 刷新次数统计
+struct tlb_stats {
+  uint64 page_flushes;    // 按页刷新次数
+  uint64 global_flushes;  // 整体刷新次数
+  uint64 remote_flushes;  // 通知其他 hart 刷新的次数
+};
+extern struct tlb_stats tlb_stats;
+extern pagetable_t kernel_pagetable;
+
+// 用户页表与可移动页反向映射的锁，页迁移的调用者须持有它（锁序在 kmem.lock 之前）
+extern struct spinlock pt_lock;
+
 pagetable_t uvmcreate(void);
 uint64 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int perm);
 uint64 uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz); // 解决隐式声明
 void uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free); // 解决隐式声明
 int mappages(pagetable_t pagetable, uint64_t va, uint64_t size, uint64_t pa, int perm);
+int mappages_sz(pagetable_t pagetable, uint64_t va, uint64_t size, uint64_t pa, int perm, uint64_t pgsz);
 pte_t *walk(pagetable_t pagetable, uint64_t va, int alloc);
+pte_t *walk_level(pagetable_t pagetable, uint64_t va, int alloc, int level);
+void destroy_pagetable(pagetable_t pt);
+void dump_pagetable(pagetable_t pt, int level);
+pagetable_t kvmmake(uint64_t pgsz);
+uint64 walkaddr(pagetable_t pagetable, uint64 va);
+int uvmprotect(pagetable_t pagetable, uint64 va, uint64 size, int perm);
+void uvmunmap_batch(pagetable_t pagetable, uint64 va, uint64 npages, int do_free, struct tlb_batch *tb);
+void tlb_batch_init(struct tlb_batch *tb, pagetable_t pagetable);
+void tlb_batch_add(struct tlb_batch *tb, uint64 va);
+void tlb_batch_free(struct tlb_batch *tb, void *pa);
+void tlb_batch_flush(struct tlb_batch *tb);
 void kvminit(void);
 void kvminithart(void);
+void kvmshare(pagetable_t pagetable);
+void uvmfree(pagetable_t pagetable);
+int uvmcopy_cow(pagetable_t old, pagetable_t new);
+int uvmcow_fault(pagetable_t pagetable, uint64 va);
+int uvm_migrate(void *old, void *new);
+
+// uvmfault 的返回值：缺页已处理的方式
+#define FAULT_LAZY 1  // 按需分配了清零页
+#define FAULT_COW  2  // 写时复制
+#define FAULT_SPURIOUS 3 // 页已映射，只是本 hart 的 TLB 过时
+int uvmlazy(pagetable_t pagetable, uint64 va, uint64 size, int perm);
+void uvmlazy_release(pagetable_t pagetable);
+int uvmfault(pagetable_t pagetable, uint64 va, int access);
+void uvmswitch(pagetable_t pagetable);
+void kvmswitch(void);
 #endif
\ No newline at end of file